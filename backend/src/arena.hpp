@@ -0,0 +1,113 @@
+#pragma once
+#include <memory_resource>
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+using namespace std;
+
+// Arena chunks are at least this large
+const size_t ARENA_CHUNK_BYTES = 64 * 1024;
+
+// reset() hands chunks back to the system beyond this much retained memory
+const size_t ARENA_RETAIN_BYTES = 16 * 1024 * 1024;
+
+// Monotonic bump allocator for per-request scratch data such as trace steps.
+// Deallocation is a no-op; memory comes back all at once with reset(), or
+// back to a mark with rewind() when a stretch of allocations is known dead.
+// Chunks are kept for the next request, so a thread serving similar requests
+// stops calling the system allocator. Not thread-safe: one per thread.
+class Arena : public pmr::memory_resource {
+private:
+    struct Chunk {
+        unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    vector<Chunk> chunks;
+    size_t current;   // chunk being filled
+    size_t used;      // bytes used in it
+
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        while (true) {
+            if (current < chunks.size()) {
+                Chunk& chunk = chunks[current];
+                uintptr_t base = reinterpret_cast<uintptr_t>(chunk.data.get());
+                size_t start = ((base + used + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+                if (start + bytes <= chunk.size) {
+                    used = start + bytes;
+                    return chunk.data.get() + start;
+                }
+                if (current + 1 < chunks.size()) {
+                    current++;
+                    used = 0;
+                    continue;
+                }
+            }
+            size_t size = max(ARENA_CHUNK_BYTES, bytes + alignment);
+            chunks.push_back({unique_ptr<char[]>(new char[size]), size});
+            current = chunks.size() - 1;
+            used = 0;
+        }
+    }
+
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+public:
+    // Position to rewind to; everything allocated after it is released
+    struct Mark {
+        size_t chunk;
+        size_t used;
+    };
+
+    Arena() : current(0), used(0) {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    Mark mark() const {
+        return {current, used};
+    }
+
+    // Release everything allocated since m; nothing from then may be in use
+    void rewind(const Mark& m) {
+        current = m.chunk;
+        used = m.used;
+    }
+
+    // Release everything, keeping up to ARENA_RETAIN_BYTES of chunks
+    void reset() {
+        size_t kept = 0, count = 0;
+        while (count < chunks.size() && kept + chunks[count].size <= ARENA_RETAIN_BYTES) {
+            kept += chunks[count++].size;
+        }
+        chunks.resize(count);
+        current = 0;
+        used = 0;
+    }
+
+    // Bytes held in chunks, used or not
+    size_t capacity() const {
+        size_t total = 0;
+        for (const auto& chunk : chunks) total += chunk.size;
+        return total;
+    }
+};
+
+// The calling thread's arena for request-scoped data. Connection workers
+// reset it once the response has been sent.
+inline Arena& requestArena() {
+    thread_local Arena arena;
+    return arena;
+}
+
+// Containers that allocate from an arena
+template <typename T>
+using ArenaVector = pmr::vector<T>;
+using ArenaString = pmr::string;
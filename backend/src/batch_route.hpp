@@ -0,0 +1,94 @@
+#pragma once
+#include "graph.hpp"
+#include "route.hpp"
+#include "distance_table.hpp"
+#include "thread_pool.hpp"
+#include "spatial_index.hpp"
+#include "../lib/json.hpp"
+#include <vector>
+#include <map>
+#include <stdexcept>
+
+using json = nlohmann::json;
+using namespace std;
+
+// Most routes one batch request may contain
+const size_t MAX_BATCH_ROUTES = 10000;
+
+struct RouteQuery {
+    int start;
+    int end;
+};
+
+// One end of a route: a node id, or {"x":..,"y":..} snapped to the nearest node
+int parseRouteEndpoint(const json& value, const SpatialIndex* index) {
+    if (!value.is_object()) return value.get<int>();
+    if (!index) throw invalid_argument("Coordinates are not supported here");
+    int node = index->snap(value.at("x").get<double>(), value.at("y").get<double>());
+    if (node == -1) throw invalid_argument("Graph has no nodes");
+    return node;
+}
+
+// Accepts [[0,9],[1,5]], [{"start":0,"end":9}] or {"routes": <either>}.
+// With an index, any end may also be given as {"x":..,"y":..}.
+vector<RouteQuery> parseRouteBatch(const json& body, const SpatialIndex* index = nullptr) {
+    const json& items = body.is_object() ? body.at("routes") : body;
+    if (!items.is_array()) throw invalid_argument("Expected an array of routes");
+    if (items.size() > MAX_BATCH_ROUTES) {
+        throw invalid_argument("Too many routes: at most " + to_string(MAX_BATCH_ROUTES));
+    }
+
+    vector<RouteQuery> queries;
+    queries.reserve(items.size());
+    for (const auto& item : items) {
+        if (item.is_array() && item.size() == 2) {
+            queries.push_back({parseRouteEndpoint(item[0], index), parseRouteEndpoint(item[1], index)});
+        } else if (item.is_object()) {
+            queries.push_back({parseRouteEndpoint(item.at("start"), index), parseRouteEndpoint(item.at("end"), index)});
+        } else {
+            throw invalid_argument("Each route must be [start, end] or {\"start\", \"end\"}");
+        }
+    }
+    return queries;
+}
+
+// Answer every query, in request order. With a ready table each route is a
+// lookup; otherwise queries are grouped by start so each group shares one
+// search tree, and the groups run in parallel. Queries with an unknown node
+// get an "error" entry instead of failing the whole batch.
+json batchRoutes(const Graph& graph, const DistanceTable* table, const vector<RouteQuery>& queries) {
+    vector<json> routes(queries.size());
+    map<int, vector<size_t>> groups;   // start -> indexes of its queries
+
+    for (size_t i = 0; i < queries.size(); i++) {
+        const RouteQuery& q = queries[i];
+        if (q.start < 0 || q.start >= graph.size() || q.end < 0 || q.end >= graph.size()) {
+            routes[i] = {{"start", q.start}, {"end", q.end}, {"error", "Invalid node id"}};
+        } else if (table && table->ready()) {
+            routes[i] = table->route(q.start, q.end).toJSON("table");
+        } else {
+            groups[q.start].push_back(i);
+        }
+    }
+
+    json result;
+    if (!groups.empty()) {
+        vector<pair<int, vector<size_t>>> work(groups.begin(), groups.end());
+        result["threads"] = parallelFor(work.size(), [&](size_t g) {
+            const vector<size_t>& members = work[g].second;
+            vector<int> ends;
+            ends.reserve(members.size());
+            for (size_t i : members) ends.push_back(queries[i].end);
+
+            vector<RouteResult> found = routesFromSource(graph, work[g].first, ends);
+            for (size_t k = 0; k < members.size(); k++) {
+                routes[members[k]] = found[k].toJSON("dijkstra");
+            }
+        });
+        result["groups"] = work.size();
+    }
+
+    result["algorithm"] = (table && table->ready()) ? "table" : "dijkstra";
+    result["routes"] = move(routes);
+    return result;
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include "compress.hpp"
+#include "../lib/json.hpp"
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <map>
+#include <mutex>
+#include <atomic>
+
+using json = nlohmann::json;
+using namespace std;
+
+// Default byte budget for cached response bodies
+const size_t RESPONSE_CACHE_BYTES = 64 * 1024 * 1024;
+
+// Build a cache key from the endpoint and its decoded parameters.
+// The map is ordered, so the same parameters in any order give the same key.
+string makeCacheKey(const string& path, const map<string, string>& params) {
+    string key = path;
+    char separator = '?';
+    for (const auto& param : params) {
+        key += separator;
+        key += param.first;
+        key += '=';
+        key += param.second;
+        separator = '&';
+    }
+    return key;
+}
+
+// A cached body and, once a client has asked for them, its compressed forms
+struct CachedBody {
+    string body;
+    string encoded[ENCODING_COUNT];   // by ContentEncoding; empty until first needed
+
+    size_t bytes() const {
+        size_t total = body.size();
+        for (const auto& variant : encoded) total += variant.size();
+        return total;
+    }
+};
+
+// Thread-safe LRU cache of serialized response bodies, bounded by total size.
+// Compressed variants count against the same budget as the bodies.
+class ResponseCache {
+private:
+    typedef list<pair<string, CachedBody>> EntryList;   // (key, body), most recent first
+
+    size_t capacityBytes;
+    size_t usedBytes;
+    EntryList entries;
+    unordered_map<string, EntryList::iterator> index;
+    mutable mutex lock;
+    atomic<unsigned long long> hits;
+    atomic<unsigned long long> misses;
+
+    void evictToFit() {
+        while (usedBytes > capacityBytes && !entries.empty()) {
+            auto& oldest = entries.back();
+            usedBytes -= oldest.first.size() + oldest.second.bytes();
+            index.erase(oldest.first);
+            entries.pop_back();
+        }
+    }
+
+public:
+    ResponseCache(size_t capacityBytes = RESPONSE_CACHE_BYTES)
+        : capacityBytes(capacityBytes), usedBytes(0), hits(0), misses(0) {}
+
+    // Copy the cached body into body and mark it recently used. encoded gets
+    // the body compressed with encoding if that variant is cached, else it is
+    // left empty.
+    bool get(const string& key, ContentEncoding encoding, string& body, string& encoded) {
+        lock_guard<mutex> guard(lock);
+        auto it = index.find(key);
+        if (it == index.end()) {
+            misses++;
+            return false;
+        }
+        entries.splice(entries.begin(), entries, it->second);
+        body = it->second->second.body;
+        encoded = it->second->second.encoded[encoding];
+        hits++;
+        return true;
+    }
+
+    void put(const string& key, const string& body) {
+        size_t entryBytes = key.size() + body.size();
+        if (entryBytes > capacityBytes) return;
+
+        lock_guard<mutex> guard(lock);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            usedBytes -= it->second->first.size() + it->second->second.bytes();
+            entries.erase(it->second);
+            index.erase(it);
+        }
+        entries.emplace_front(key, CachedBody());
+        entries.front().second.body = body;
+        index[key] = entries.begin();
+        usedBytes += entryBytes;
+        evictToFit();
+    }
+
+    // Keep the compressed form of an entry's body; ignored if the entry has
+    // been evicted meanwhile
+    void putEncoded(const string& key, ContentEncoding encoding, const string& encoded) {
+        lock_guard<mutex> guard(lock);
+        auto it = index.find(key);
+        if (it == index.end()) return;
+        string& variant = it->second->second.encoded[encoding];
+        usedBytes += encoded.size();
+        usedBytes -= variant.size();
+        variant = encoded;
+        evictToFit();
+    }
+
+    // Drop everything, e.g. after the graph changed
+    void clear() {
+        lock_guard<mutex> guard(lock);
+        entries.clear();
+        index.clear();
+        usedBytes = 0;
+    }
+
+    void setCapacity(size_t bytes) {
+        lock_guard<mutex> guard(lock);
+        capacityBytes = bytes;
+        evictToFit();
+    }
+
+    unsigned long long hitCount() const {
+        return hits;
+    }
+
+    unsigned long long missCount() const {
+        return misses;
+    }
+
+    json stats() const {
+        lock_guard<mutex> guard(lock);
+        json j;
+        j["hits"] = hits.load();
+        j["misses"] = misses.load();
+        j["entries"] = entries.size();
+        j["bytes"] = usedBytes;
+        j["capacityBytes"] = capacityBytes;
+        return j;
+    }
+};
@@ -0,0 +1,329 @@
+// End-to-end benchmark of the query functions on synthetic campuses of
+// growing size. Each operation runs until it has answered --queries
+// queries or used its --seconds budget (at least 3 queries), and the
+// results are written as JSON so runs can be compared between releases:
+//   campus_bench [--sizes 1000,10000,100000,1000000] [--queries 200]
+//                [--seconds 2] [--trace-max-nodes 10000] [--sort-trace-max-nodes 2000]
+//                [--seed 1] [--out bench.json]
+// Every operation names the function it times. Trace modes call
+// getDijkstraPath, searchBuilding and sortLocationsByDistance with delta
+// traces; "trace-streamed" is the same trace streamed into a byte counter,
+// as the server sends it to HTTP/1.1 clients. Only sorting has a fast mode
+// of its own: fast Dijkstra is getShortestRoute, the trace-free route, and
+// searchBuilding's answer is its trace, so fast search is suggestBuildings.
+// A delta sort trace grows with the square of the places (measured: 40 MB
+// at 1k places, 150 MB at 2k), so traces are only run up to the
+// --*-max-nodes sizes.
+// Each size runs in a process of its own (except on Windows), so its
+// peakRssKB is that of the size alone; peakRssScope says which it is.
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "graph.hpp"
+#include "synthetic_graph.hpp"
+#include "dijkstra.hpp"
+#include "route.hpp"
+#include "search.hpp"
+#include "sort.hpp"
+#include "distance_sort.hpp"
+#include "distance_kernel.hpp"
+#include "json_stream.hpp"
+#include "arena.hpp"
+#include "../lib/json.hpp"
+
+using json = nlohmann::json;
+using namespace std;
+
+// Counts the bytes of a streamed response and drops them
+class CountingSink : public JsonSink {
+public:
+    size_t bytes = 0;
+
+    void write(string_view data) override {
+        bytes += data.size();
+    }
+};
+
+// Peak resident set size of this process so far, in KB
+long long peakRssKB() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return -1;
+    return static_cast<long long>(counters.PeakWorkingSetSize / 1024);
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;   // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+struct BenchOptions {
+    vector<int> sizes = {1000, 10000, 100000, 1000000};
+    int queries = 200;
+    double seconds = 2;
+    int traceMaxNodes = 10000;
+    int sortTraceMaxNodes = 2000;
+    unsigned int seed = 1;
+    string out;
+};
+
+// Latency at percentile p (0-100) of sorted samples, nearest rank
+double percentile(const vector<double>& sorted, double p) {
+    size_t rank = static_cast<size_t>(ceil(p / 100 * sorted.size()));
+    return sorted[min(sorted.size(), max<size_t>(rank, 1)) - 1];
+}
+
+// Run query(i) for i = 0, 1, ... within the options' budget. query returns
+// the response size in bytes. The request arena is reset after every query,
+// as the server does after every response.
+json measure(const string& name, const string& mode, const string& function, const BenchOptions& options,
+             const std::function<size_t(int)>& query) {
+    vector<double> millis;
+    size_t bytes = 0;
+    auto begin = chrono::steady_clock::now();
+    double elapsed = 0;
+    while ((int)millis.size() < options.queries && (millis.size() < 3 || elapsed < options.seconds)) {
+        auto start = chrono::steady_clock::now();
+        bytes += query(static_cast<int>(millis.size()));
+        requestArena().reset();
+        auto stop = chrono::steady_clock::now();
+        millis.push_back(chrono::duration<double, milli>(stop - start).count());
+        elapsed = chrono::duration<double>(stop - begin).count();
+    }
+
+    sort(millis.begin(), millis.end());
+    double total = 0;
+    for (double ms : millis) total += ms;
+
+    json result;
+    result["name"] = name;
+    result["mode"] = mode;
+    result["function"] = function;
+    result["queries"] = millis.size();
+    result["seconds"] = total / 1000;
+    result["queriesPerSecond"] = millis.size() / (total / 1000);
+    result["latencyMs"] = {
+        {"mean", total / millis.size()},
+        {"p50", percentile(millis, 50)},
+        {"p90", percentile(millis, 90)},
+        {"p99", percentile(millis, 99)},
+        {"max", millis.back()}
+    };
+    result["bytesPerQuery"] = bytes / millis.size();
+    return result;
+}
+
+json skipped(const string& name, const string& mode, const string& reason) {
+    return {{"name", name}, {"mode", mode}, {"skipped", reason}};
+}
+
+json benchSize(int nodes, const BenchOptions& options) {
+    auto begin = chrono::steady_clock::now();
+    Graph g = createSyntheticCampus(nodes, options.seed);
+    double generateMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+
+    // The same random queries for every operation of this size
+    mt19937 rng(options.seed + nodes);
+    uniform_int_distribution<int> node(0, nodes - 1);
+    vector<int> from(options.queries), to(options.queries);
+    vector<string> names(options.queries), prefixes(options.queries);
+    for (int i = 0; i < options.queries; i++) {
+        from[i] = node(rng);
+        to[i] = node(rng);
+        names[i] = string(g.getName(node(rng)));
+        prefixes[i] = names[i].substr(0, max<size_t>(3, names[i].size() - 2));
+    }
+
+    json operations = json::array();
+
+    if (nodes <= options.traceMaxNodes) {
+        operations.push_back(measure("dijkstra", "trace", "getDijkstraPath", options, [&](int i) {
+            return getDijkstraPath(g, from[i], to[i], TRACE_DELTA).dump().size();
+        }));
+        operations.push_back(measure("dijkstra", "trace-streamed", "streamDijkstraPath", options, [&](int i) {
+            CountingSink sink;
+            JsonWriter out(sink);
+            streamDijkstraPath(g, from[i], to[i], TRACE_DELTA, false, false, out);
+            return sink.bytes;
+        }));
+    } else {
+        operations.push_back(skipped("dijkstra", "trace", "larger than --trace-max-nodes"));
+        operations.push_back(skipped("dijkstra", "trace-streamed", "larger than --trace-max-nodes"));
+    }
+    operations.push_back(measure("dijkstra", "fast", "getShortestRoute", options, [&](int i) {
+        return getShortestRoute(g, from[i], to[i]).dump().size();
+    }));
+
+    operations.push_back(measure("search", "trace", "searchBuilding", options, [&](int i) {
+        return searchBuilding(g, names[i]).dump().size();
+    }));
+    operations.push_back(measure("search", "fast", "suggestBuildings", options, [&](int i) {
+        return suggestBuildings(g, prefixes[i], 10).dump().size();
+    }));
+
+    if (nodes <= options.sortTraceMaxNodes) {
+        operations.push_back(measure("sort", "trace", "sortLocationsByDistance", options, [&](int i) {
+            return sortLocationsByDistance(g, from[i], TRACE_DELTA).dump().size();
+        }));
+        operations.push_back(measure("sort", "trace-streamed", "streamLocationsByDistance", options, [&](int i) {
+            CountingSink sink;
+            JsonWriter out(sink);
+            streamLocationsByDistance(g, from[i], TRACE_DELTA, out);
+            return sink.bytes;
+        }));
+    } else {
+        operations.push_back(skipped("sort", "trace", "larger than --sort-trace-max-nodes"));
+        operations.push_back(skipped("sort", "trace-streamed", "larger than --sort-trace-max-nodes"));
+    }
+    operations.push_back(measure("sort", "fast", "rankLocationsByDistance", options, [&](int i) {
+        return rankLocationsByDistance(g, from[i], 0).dump().size();
+    }));
+    operations.push_back(measure("sort", "top-k", "rankLocationsByDistance", options, [&](int i) {
+        return rankLocationsByDistance(g, from[i], 10).dump().size();
+    }));
+
+    json result;
+    result["nodes"] = nodes;
+    result["edges"] = g.getEdges().size();
+    result["generateMs"] = generateMillis;
+    result["operations"] = move(operations);
+    result["peakRssKB"] = peakRssKB();
+    result["peakRssScope"] = "run";   // runSize() narrows it when the size had its own process
+    return result;
+}
+
+// benchSize in a child process, so peak RSS covers this size only. Windows
+// has no fork: there the size runs here and its peak includes earlier sizes.
+json runSize(int nodes, const BenchOptions& options) {
+#ifdef _WIN32
+    return benchSize(nodes, options);
+#else
+    int fds[2];
+    if (pipe(fds) != 0) throw runtime_error("Cannot create a pipe");
+    cout.flush();
+    cerr.flush();
+    pid_t child = fork();
+    if (child < 0) throw runtime_error("Cannot fork");
+    if (child == 0) {
+        close(fds[0]);
+        int status = 0;
+        try {
+            json result = benchSize(nodes, options);
+            result["peakRssScope"] = "size";
+            string text = result.dump();
+            for (size_t sent = 0; sent < text.size();) {
+                ssize_t n = write(fds[1], text.data() + sent, text.size() - sent);
+                if (n <= 0) {
+                    status = 1;
+                    break;
+                }
+                sent += n;
+            }
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            status = 1;
+        }
+        _exit(status);
+    }
+
+    close(fds[1]);
+    string text;
+    char buffer[64 * 1024];
+    ssize_t n;
+    while ((n = read(fds[0], buffer, sizeof(buffer))) > 0) text.append(buffer, n);
+    close(fds[0]);
+    int status;
+    if (waitpid(child, &status, 0) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        throw runtime_error("Benchmark of " + to_string(nodes) + " nodes failed");
+    }
+    return json::parse(text);
+#endif
+}
+
+vector<int> parseSizes(const string& list) {
+    vector<int> sizes;
+    size_t begin = 0;
+    while (begin <= list.size()) {
+        size_t end = list.find(',', begin);
+        if (end == string::npos) end = list.size();
+        int size = stoi(list.substr(begin, end - begin));
+        if (size < 2) throw invalid_argument("Sizes must be at least 2 nodes");
+        sizes.push_back(size);
+        begin = end + 1;
+    }
+    return sizes;
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    try {
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            if (i + 1 >= argc) throw invalid_argument("Missing value for " + arg);
+            string value = argv[++i];
+            if (arg == "--sizes") options.sizes = parseSizes(value);
+            else if (arg == "--queries") options.queries = stoi(value);
+            else if (arg == "--seconds") options.seconds = stod(value);
+            else if (arg == "--trace-max-nodes") options.traceMaxNodes = stoi(value);
+            else if (arg == "--sort-trace-max-nodes") options.sortTraceMaxNodes = stoi(value);
+            else if (arg == "--seed") options.seed = stoul(value);
+            else if (arg == "--out") options.out = value;
+            else throw invalid_argument("Unknown option " + arg);
+        }
+        if (options.queries < 3) throw invalid_argument("--queries must be at least 3");
+    }
+    catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        cerr << "Usage: " << argv[0] << " [--sizes 1000,10000,...] [--queries 200] [--seconds 2]"
+             << " [--trace-max-nodes 10000] [--sort-trace-max-nodes 2000] [--seed 1] [--out bench.json]" << endl;
+        return 1;
+    }
+
+    json report;
+    report["benchmark"] = "campus_bench";
+    report["distanceKernel"] = distanceKernelName();
+    report["threads"] = defaultThreadCount();
+    report["seed"] = options.seed;
+    report["sizes"] = json::array();
+    for (int nodes : options.sizes) {
+        cerr << "Benchmarking " << nodes << " nodes..." << endl;
+        try {
+            report["sizes"].push_back(runSize(nodes, options));
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+    }
+
+    string text = report.dump(2) + "\n";
+    if (options.out.empty()) {
+        cout << text;
+    } else {
+        ofstream file(options.out);
+        file << text;
+        if (!file) {
+            cerr << "Error: cannot write " << options.out << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,154 @@
+#pragma once
+#include "http.hpp"
+#include <zlib.h>
+#include <string>
+#include <string_view>
+#include <cstdlib>
+#include <cstdio>
+#include <stdexcept>
+
+using namespace std;
+
+// Dynamic responses smaller than this are sent uncompressed
+const size_t COMPRESS_MIN_BYTES = 1024;
+
+// zlib level for bodies compressed per request; precomputed ones use the best
+const int DYNAMIC_COMPRESSION_LEVEL = 4;
+
+enum ContentEncoding {
+    ENCODING_IDENTITY,
+    ENCODING_GZIP,
+    ENCODING_DEFLATE,  // zlib-wrapped, as HTTP "deflate" is defined
+    ENCODING_COUNT
+};
+
+const char* contentEncodingName(ContentEncoding encoding) {
+    switch (encoding) {
+        case ENCODING_GZIP: return "gzip";
+        case ENCODING_DEFLATE: return "deflate";
+        default: return "identity";
+    }
+}
+
+// Best encoding allowed by an Accept-Encoding header. Honours q-values
+// (q=0 forbids a coding) and "*"; gzip wins ties.
+ContentEncoding acceptedEncoding(string_view acceptEncoding) {
+    double gzipQ = -1, deflateQ = -1, anyQ = -1;
+
+    while (!acceptEncoding.empty()) {
+        size_t comma = acceptEncoding.find(',');
+        string_view item = acceptEncoding.substr(0, comma);
+        size_t semicolon = item.find(';');
+        string_view coding = trimView(item.substr(0, semicolon));
+
+        double q = 1;
+        if (semicolon != string_view::npos) {
+            string_view param = trimView(item.substr(semicolon + 1));
+            if (param.substr(0, 2) == "q=" || param.substr(0, 2) == "Q=") {
+                q = strtod(string(param.substr(2)).c_str(), nullptr);
+            }
+        }
+
+        if (equalsIgnoreCase(coding, "gzip") || equalsIgnoreCase(coding, "x-gzip")) gzipQ = q;
+        else if (equalsIgnoreCase(coding, "deflate")) deflateQ = q;
+        else if (coding == "*") anyQ = q;
+
+        if (comma == string_view::npos) break;
+        acceptEncoding.remove_prefix(comma + 1);
+    }
+
+    if (gzipQ < 0) gzipQ = anyQ;
+    if (deflateQ < 0) deflateQ = anyQ;
+    if (gzipQ > 0 && gzipQ >= deflateQ) return ENCODING_GZIP;
+    if (deflateQ > 0) return ENCODING_DEFLATE;
+    return ENCODING_IDENTITY;
+}
+
+// Incremental compressor: feed data in pieces, compressed bytes are
+// appended to the output as zlib produces them
+class Deflater {
+private:
+    z_stream zs;
+
+    void run(string_view input, string& out, int flush) {
+        char buffer[16 * 1024];
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+        zs.avail_in = static_cast<uInt>(input.size());
+        do {
+            zs.next_out = reinterpret_cast<Bytef*>(buffer);
+            zs.avail_out = sizeof(buffer);
+            deflate(&zs, flush);
+            out.append(buffer, sizeof(buffer) - zs.avail_out);
+        } while (zs.avail_out == 0);
+    }
+
+public:
+    Deflater(ContentEncoding encoding, int level = DYNAMIC_COMPRESSION_LEVEL) {
+        zs = z_stream();
+        // 15-bit window; +16 selects the gzip wrapper instead of zlib
+        int windowBits = (encoding == ENCODING_GZIP) ? 15 + 16 : 15;
+        if (deflateInit2(&zs, level, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw runtime_error("deflateInit2 failed");
+        }
+    }
+
+    ~Deflater() {
+        deflateEnd(&zs);
+    }
+
+    Deflater(const Deflater&) = delete;
+    Deflater& operator=(const Deflater&) = delete;
+
+    void write(string_view input, string& out) {
+        if (!input.empty()) run(input, out, Z_NO_FLUSH);
+    }
+
+    // Flush everything and write the trailer
+    void finish(string& out) {
+        run(string_view(), out, Z_FINISH);
+    }
+};
+
+// Compress a whole body at once
+string compressBody(string_view body, ContentEncoding encoding, int level = DYNAMIC_COMPRESSION_LEVEL) {
+    string out;
+    out.reserve(body.size() / 4 + 64);
+    Deflater deflater(encoding, level);
+    deflater.write(body, out);
+    deflater.finish(out);
+    return out;
+}
+
+// Strong entity tag for a body (FNV-1a, 64 bit)
+string makeETag(string_view body) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (unsigned char c : body) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    char tag[24];
+    snprintf(tag, sizeof(tag), "\"%016llx\"", hash);
+    return tag;
+}
+
+// Tag of the encoded copy of a body tagged etag: different bytes need their
+// own strong tag, so "<hash>" becomes "<hash>-gz" or "<hash>-df"
+string encodedETag(const string& etag, ContentEncoding encoding) {
+    if (encoding == ENCODING_IDENTITY || etag.size() < 2) return etag;
+    const char* suffix = encoding == ENCODING_GZIP ? "-gz" : "-df";
+    return etag.substr(0, etag.size() - 1) + suffix + '"';
+}
+
+// True if an If-None-Match header lists the tag (weak comparison) or is "*"
+bool etagMatches(string_view ifNoneMatch, string_view etag) {
+    while (!ifNoneMatch.empty()) {
+        size_t comma = ifNoneMatch.find(',');
+        string_view candidate = trimView(ifNoneMatch.substr(0, comma));
+        if (candidate.substr(0, 2) == "W/") candidate.remove_prefix(2);
+        if (candidate == "*" || candidate == etag) return true;
+
+        if (comma == string_view::npos) break;
+        ifNoneMatch.remove_prefix(comma + 1);
+    }
+    return false;
+}
@@ -0,0 +1,292 @@
+#pragma once
+#include "net.hpp"
+#include "poller.hpp"
+#include "http.hpp"
+#include "logger.hpp"
+#include "thread_pool.hpp"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+using namespace std;
+
+// Streamed responses stop to wait for the client once this much is queued
+const size_t STREAM_QUEUE_BYTES = 1024 * 1024;
+
+// A streaming worker gives up on a client that takes nothing for this long.
+// It holds the worker, so it is far shorter than SEND_TIMEOUT_MS, but long
+// enough for a rate-limited reader to drain its socket buffer.
+const int STREAM_STALL_TIMEOUT_MS = 5000;
+
+// One client connection. The event loop owns it; while a worker is serving
+// it the socket is disarmed and only that worker touches it.
+struct Connection {
+    socket_t socket;
+    string pending;                 // received bytes not answered yet
+    HttpRequestParser parser;
+    int served;                     // requests answered so far
+    chrono::steady_clock::time_point lastActive;
+    bool busy;                      // with a worker
+    string outbox;                  // response bytes the socket has not taken yet
+    size_t outboxSent;              // of them, already written
+    bool sendFailed;
+    bool closeWhenSent;             // close once the outbox is written
+
+    explicit Connection(socket_t socket)
+        : socket(socket), served(0), lastActive(chrono::steady_clock::now()), busy(false),
+          outboxSent(0), sendFailed(false), closeWhenSent(false) {}
+
+    size_t unsent() const {
+        return outbox.size() - outboxSent;
+    }
+
+    // Write as much of the outbox as the socket takes now, without blocking.
+    // False once the connection has failed.
+    bool flushSome() {
+        while (!sendFailed && unsent() > 0) {
+            IoSlice part = {outbox.data() + outboxSent, unsent()};
+            long long sent = sendSome(socket, &part, 1);
+            if (sent == NET_WOULD_BLOCK || sent == 0) break;
+            if (sent < 0) {
+                sendFailed = true;
+                break;
+            }
+            outboxSent += static_cast<size_t>(sent);
+            lastActive = chrono::steady_clock::now();
+        }
+        if (unsent() == 0) {
+            outbox.clear();
+            outboxSent = 0;
+        }
+        return !sendFailed;
+    }
+
+    // Send parts after everything sent before them. What the socket does not
+    // take at once is copied to the outbox, which the event loop writes when
+    // the client reads, so a worker never waits on a slow reader here.
+    // False once the connection has failed.
+    bool send(const IoSlice* parts, size_t count) {
+        if (sendFailed) return false;
+        size_t first = 0;   // first part not yet sent or queued
+        while (unsent() == 0 && first < count) {
+            long long sent = sendSome(socket, parts + first, count - first);
+            if (sent == NET_WOULD_BLOCK || sent == 0) break;
+            if (sent < 0) {
+                sendFailed = true;
+                return false;
+            }
+            size_t left = static_cast<size_t>(sent);
+            while (first < count && left >= parts[first].size) {
+                left -= parts[first].size;
+                first++;
+            }
+            if (left > 0) {
+                // Part of a slice went out: queue its rest, the later slices follow it
+                outbox.append(parts[first].data + left, parts[first].size - left);
+                first++;
+            }
+        }
+        for (size_t i = first; i < count; i++) outbox.append(parts[i].data, parts[i].size);
+        return true;
+    }
+
+    bool send(string_view data) {
+        IoSlice part = {data.data(), data.size()};
+        return send(&part, 1);
+    }
+
+    // Block until at most limit bytes are queued, for streamed responses
+    // that would otherwise queue their whole body. Fails if the client takes
+    // nothing for timeoutMs.
+    bool drainTo(size_t limit, int timeoutMs) {
+        while (flushSome() && unsent() > limit) {
+            if (!waitWritable(socket, timeoutMs)) {
+                sendFailed = true;
+            }
+        }
+        return !sendFailed;
+    }
+};
+
+// Accepts connections and keeps the idle ones in a Poller, so an open
+// keep-alive connection costs a socket and a small buffer instead of a
+// blocked worker thread. A connection that becomes readable goes to a
+// worker, which calls serve() to read and answer whatever has arrived;
+// serve() returns false to close the connection. The worker hands it back
+// and the loop rearms or closes it. Responses the client has not read yet
+// stay in the connection's outbox, and the loop writes them as the socket
+// drains. Connections left idle for idleTimeoutSeconds, or that take none
+// of their outbox for SEND_TIMEOUT_MS, are closed.
+class ConnectionLoop {
+private:
+    ThreadPool& workers;
+    Logger& log;
+    atomic<int>& openConnections;
+    int idleTimeoutSeconds;
+    function<bool(Connection&)> serve;
+
+    Poller poller;
+    unordered_map<socket_t, unique_ptr<Connection>> connections;
+    socket_t listener;
+    bool listening;   // listener armed; off for a moment after accept fails
+
+    mutex finishedLock;
+    vector<pair<Connection*, bool>> finished;   // (connection, keep open) handed back by workers
+
+    void acceptAll() {
+        while (true) {
+            socket_t s = acceptClient(listener);
+            if (s == NO_SOCKET) {
+                if (!netWouldBlock()) {
+                    // Out of descriptors, say: retry on the next sweep instead of spinning
+                    log.warn("Error accepting connection: " + to_string(lastNetError()));
+                    return;
+                }
+                break;
+            }
+            unique_ptr<Connection> connection(new Connection(s));
+            if (!poller.watch(s)) {
+                closeSocket(s);
+                continue;
+            }
+            connections[s] = move(connection);
+            openConnections++;
+        }
+        poller.rearm(listener);
+        listening = true;
+    }
+
+    void dispatch(Connection* connection) {
+        connection->busy = true;
+        workers.submit([this, connection] {
+            bool keep;
+            try {
+                keep = serve(*connection);
+            } catch (const exception& e) {
+                log.error(string("Connection failed: ") + e.what());
+                keep = false;
+            }
+            {
+                lock_guard<mutex> guard(finishedLock);
+                finished.push_back({connection, keep});
+            }
+            poller.wake();
+        });
+    }
+
+    void closeConnection(Connection* connection) {
+        socket_t s = connection->socket;
+        poller.forget(s);
+        closeSocket(s);
+        connections.erase(s);
+        openConnections--;
+    }
+
+    void collectFinished() {
+        vector<pair<Connection*, bool>> done;
+        {
+            lock_guard<mutex> guard(finishedLock);
+            done.swap(finished);
+        }
+        auto now = chrono::steady_clock::now();
+        for (const auto& item : done) {
+            Connection* connection = item.first;
+            connection->busy = false;
+            connection->lastActive = now;
+            if (connection->sendFailed) {
+                closeConnection(connection);
+            } else if (connection->unsent() > 0) {
+                // Even a connection about to close gets its last response
+                connection->closeWhenSent = !item.second;
+                poller.rearmWritable(connection->socket);
+            } else if (item.second) {
+                poller.rearm(connection->socket);
+            } else {
+                closeConnection(connection);
+            }
+        }
+    }
+
+    // The socket of a connection with queued output can take more
+    void writeQueued(Connection* connection) {
+        if (!connection->flushSome()) {
+            closeConnection(connection);
+        } else if (connection->unsent() > 0) {
+            poller.rearmWritable(connection->socket);
+        } else if (connection->closeWhenSent) {
+            closeConnection(connection);
+        } else if (!connection->pending.empty()) {
+            dispatch(connection);   // pipelined requests held back while the outbox was full
+        } else {
+            poller.rearm(connection->socket);
+        }
+    }
+
+    void closeIdle() {
+        auto now = chrono::steady_clock::now();
+        auto idleLimit = now - chrono::seconds(idleTimeoutSeconds);
+        auto sendLimit = now - chrono::milliseconds(SEND_TIMEOUT_MS);
+        vector<Connection*> idle;
+        for (const auto& entry : connections) {
+            const Connection& connection = *entry.second;
+            if (connection.busy) continue;
+            if (connection.lastActive < (connection.unsent() > 0 ? sendLimit : idleLimit)) {
+                idle.push_back(entry.second.get());
+            }
+        }
+        for (Connection* connection : idle) closeConnection(connection);
+    }
+
+public:
+    ConnectionLoop(ThreadPool& workers, Logger& log, atomic<int>& openConnections, int idleTimeoutSeconds,
+                   function<bool(Connection&)> serve)
+        : workers(workers), log(log), openConnections(openConnections), idleTimeoutSeconds(idleTimeoutSeconds),
+          serve(move(serve)), listener(NO_SOCKET), listening(false) {}
+
+    ConnectionLoop(const ConnectionLoop&) = delete;
+    ConnectionLoop& operator=(const ConnectionLoop&) = delete;
+
+    static const char* backendName() {
+        return Poller::name();
+    }
+
+    // Serve connections on a non-blocking listening socket; does not return
+    void run(socket_t listeningSocket) {
+        listener = listeningSocket;
+        poller.watch(listener);
+        listening = true;
+
+        vector<socket_t> ready;
+        auto lastSweep = chrono::steady_clock::now();
+        while (true) {
+            poller.wait(ready, 1000);
+            for (socket_t s : ready) {
+                if (s == listener) {
+                    listening = false;
+                    acceptAll();
+                    continue;
+                }
+                auto it = connections.find(s);
+                if (it == connections.end() || it->second->busy) continue;
+                if (it->second->unsent() > 0) {
+                    writeQueued(it->second.get());
+                } else {
+                    dispatch(it->second.get());
+                }
+            }
+            collectFinished();
+
+            auto now = chrono::steady_clock::now();
+            if (now - lastSweep >= chrono::seconds(1)) {
+                closeIdle();
+                if (!listening) acceptAll();
+                lastSweep = now;
+            }
+        }
+    }
+};
@@ -1,36 +1,93 @@
 #pragma once
 #include "graph.hpp"
+#include "trace.hpp"
+#include "json_stream.hpp"
+#include "indexed_heap.hpp"
+#include "arena.hpp"
 #include "../lib/json.hpp"
-#include <queue>
 #include <vector>
 #include <algorithm>
 
 using json = nlohmann::json;
 using namespace std;
 
-// Step structure for visualization
+// Changes made to the search state since the previous step
+struct DijkstraDelta {
+    int visit;                               // node marked visited, -1 if none
+    ArenaVector<pair<int, int>> distances;   // (node, new distance)
+    ArenaVector<pair<int, int>> previous;    // (node, new predecessor)
+    int pops;                                // entries removed from the queue front
+    ArenaVector<pair<int, int>> pushes;      // (key, node) queued; replaces that node's entry if queued
+    
+    explicit DijkstraDelta(Arena& arena = requestArena())
+        : visit(-1), distances(&arena), previous(&arena), pops(0), pushes(&arena) {}
+};
+
+// What a step did. Clients render the text from the code and its arguments.
+enum DijkstraStepCode {
+    DIJKSTRA_START,     // search starts at node
+    DIJKSTRA_VISIT,     // node settled with distance d (A*: estimate h to go)
+    DIJKSTRA_RELAX,     // edge node -> v gave v the shorter distance d
+    DIJKSTRA_REACHED    // node is the destination, d away
+};
+
+const char* dijkstraStepCodeName(DijkstraStepCode code) {
+    switch (code) {
+        case DIJKSTRA_START: return "start";
+        case DIJKSTRA_VISIT: return "visit";
+        case DIJKSTRA_RELAX: return "relax";
+        default: return "reached";
+    }
+}
+
+// Step structure for visualization; its data lives in the request arena
 struct DijkstraStep {
     int stepNum;
     int currentNode;
-    string action;
-    string explanation;
-    vector<bool> visited;
-    vector<int> distances;
-    vector<int> previous;
-    vector<int> currentQueue;  // For visualization
+    DijkstraStepCode code;
+    int other;                 // relax: the node whose distance dropped
+    int value;                 // visit, relax, reached: the distance
+    int estimate;              // A* visit: lower bound still to go, -1 otherwise
+    ArenaString action;        // Only with server-side text
+    ArenaString explanation;
+    ArenaVector<bool> visited;
+    ArenaVector<int> distances;
+    ArenaVector<int> previous;
+    ArenaVector<int> currentQueue;  // For visualization
+    
+    // Delta traces only
+    bool isDelta;
+    bool keyframe;
+    ArenaVector<pair<int, int>> heap;  // Ordered (distance, node) queue at a keyframe
+    DijkstraDelta delta;
     
-    DijkstraStep() : stepNum(0), currentNode(-1) {}
+    explicit DijkstraStep(Arena& arena = requestArena())
+        : stepNum(0), currentNode(-1), code(DIJKSTRA_START), other(-1), value(-1), estimate(-1),
+          action(&arena), explanation(&arena), visited(&arena), distances(&arena), previous(&arena),
+          currentQueue(&arena),
+          isDelta(false), keyframe(false), heap(&arena), delta(arena) {}
     
-    json toJSON(const Graph& g) const {
+    json toJSON() const {
         json j;
         j["step"] = stepNum;
         j["node"] = currentNode;
-        j["action"] = action;
-        j["explanation"] = explanation;
+        j["code"] = dijkstraStepCodeName(code);
+        if (code == DIJKSTRA_RELAX) j["v"] = other;
+        if (code != DIJKSTRA_START) j["d"] = value;
+        if (estimate != -1) j["h"] = estimate;
+        if (!action.empty()) {
+            j["action"] = action;
+            j["explanation"] = explanation;
+        }
+        
+        if (isDelta) {
+            return addDeltaJSON(j);
+        }
+        
         j["visited"] = visited;
         
         // Convert distances (INF to -1 for JSON)
-        vector<int> distCopy = distances;
+        vector<int> distCopy(distances.begin(), distances.end());
         for (auto& d : distCopy) {
             if (d == INF) d = -1;
         }
@@ -40,115 +97,258 @@ struct DijkstraStep {
         
         return j;
     }
+    
+    // Same content as toJSON, written straight to a stream
+    void writeJSON(JsonWriter& out) const {
+        out.beginObject();
+        out.field("step", stepNum);
+        out.field("node", currentNode);
+        out.field("code", dijkstraStepCodeName(code));
+        if (code == DIJKSTRA_RELAX) out.field("v", other);
+        if (code != DIJKSTRA_START) out.field("d", value);
+        if (estimate != -1) out.field("h", estimate);
+        if (!action.empty()) {
+            out.field("action", action);
+            out.field("explanation", explanation);
+        }
+        
+        if (!isDelta || keyframe) {
+            if (keyframe) out.field("keyframe", true);
+            out.field("visited", visited);
+            out.key("distances");
+            out.beginArray();
+            for (int d : distances) out.value(d == INF ? -1 : d);
+            out.endArray();
+            out.field("previous", previous);
+            if (isDelta) {
+                out.field("heap", heap);
+            } else {
+                out.field("queue", currentQueue);
+            }
+        } else {
+            if (delta.visit != -1) out.field("visit", delta.visit);
+            if (!delta.distances.empty()) out.field("dist", delta.distances);
+            if (!delta.previous.empty()) out.field("prev", delta.previous);
+            if (delta.pops > 0) out.field("pop", delta.pops);
+            if (!delta.pushes.empty()) out.field("push", delta.pushes);
+        }
+        out.endObject();
+    }
+    
+private:
+    // Keyframes carry the full state, other steps only the changes.
+    // Clients apply pops before pushes.
+    json& addDeltaJSON(json& j) const {
+        if (keyframe) {
+            vector<int> distCopy(distances.begin(), distances.end());
+            for (auto& d : distCopy) {
+                if (d == INF) d = -1;
+            }
+            j["keyframe"] = true;
+            j["visited"] = visited;
+            j["distances"] = distCopy;
+            j["previous"] = previous;
+            j["heap"] = heap;
+            return j;
+        }
+        
+        if (delta.visit != -1) j["visit"] = delta.visit;
+        if (!delta.distances.empty()) j["dist"] = delta.distances;
+        if (!delta.previous.empty()) j["prev"] = delta.previous;
+        if (delta.pops > 0) j["pop"] = delta.pops;
+        if (!delta.pushes.empty()) j["push"] = delta.pushes;
+        return j;
+    }
 };
 
 class DijkstraVisualizer {
 private:
     const Graph& graph;
-    vector<DijkstraStep> steps;
+    Arena& arena;                // Trace data, released after the response is sent
+    Arena::Mark streamMark;      // Streaming: arena position to rewind to after each step
+    ArenaVector<DijkstraStep> steps;
     int stepNum;
+    TraceFormat format;
+    bool useHeuristic;      // A*: order the queue by dist + lower bound to the target
+    vector<int> lowerBounds; // A*: lower bound from each node to the target
+    bool withText;          // Render action/explanation text into each step
+    DijkstraDelta pending;  // Changes since the last recorded step (delta traces)
+    JsonWriter* stream;     // When set, steps are written here instead of kept
+    
+    string nameOf(int v) const {
+        return string(graph.getName(v));
+    }
     
-    void recordStep(int currentNode, const string& action, const string& explanation,
+    // English text for a step, only built when asked for
+    void describe(DijkstraStep& step) const {
+        string name = nameOf(step.currentNode);
+        switch (step.code) {
+            case DIJKSTRA_START:
+                step.action = "Starting at " + name;
+                step.explanation = "Initialize distance to start node as 0, all others as infinity. "
+                                   "Add start node to priority queue.";
+                break;
+            case DIJKSTRA_VISIT:
+                step.action = "Visiting " + name;
+                step.explanation = useHeuristic
+                    ? "Selected " + name + " as it has the minimum estimated total (" + to_string(step.value) +
+                      "m walked + " + to_string(step.estimate) + "m to go) among unvisited nodes. Mark it as visited."
+                    : "Selected " + name + " as it has the minimum distance (" + to_string(step.value) +
+                      "m) among unvisited nodes. Mark it as visited.";
+                break;
+            case DIJKSTRA_RELAX:
+                step.action = "Relaxing edge to " + nameOf(step.other);
+                step.explanation = "Found shorter path to " + nameOf(step.other) + " via " + name + ". " +
+                                   "Updated distance: " + to_string(step.value) + "m " +
+                                   "(previous: " + to_string(step.value) + "m).";
+                break;
+            case DIJKSTRA_REACHED:
+                step.action = "Reached destination: " + name;
+                step.explanation = "Found shortest path! Total distance: " + to_string(step.value) + "m";
+                break;
+        }
+    }
+    
+    // Queue key for a node reached with distance d
+    int priority(int v, int d) const {
+        return useHeuristic ? d + lowerBounds[v] : d;
+    }
+    
+    void recordStep(int currentNode, DijkstraStepCode code, int other, int value, int estimate,
                    const vector<bool>& visited, const vector<int>& distances,
-                   const vector<int>& previous, const vector<int>& queue) {
-        DijkstraStep step;
+                   const vector<int>& previous, const IndexedHeap& pq) {
+        DijkstraStep step(arena);
         step.stepNum = stepNum++;
         step.currentNode = currentNode;
-        step.action = action;
-        step.explanation = explanation;
-        step.visited = visited;
-        step.distances = distances;
-        step.previous = previous;
-        step.currentQueue = queue;
-        steps.push_back(step);
+        step.code = code;
+        step.other = other;
+        step.value = value;
+        step.estimate = estimate;
+        if (withText) describe(step);
+        
+        if (format == TRACE_DELTA) {
+            step.isDelta = true;
+            step.keyframe = isKeyframe(step.stepNum);
+            if (step.keyframe) {
+                step.visited.assign(visited.begin(), visited.end());
+                step.distances.assign(distances.begin(), distances.end());
+                step.previous.assign(previous.begin(), previous.end());
+                step.heap.reserve(pq.size());
+                pq.forEachOrdered([&](const pair<int, int>& entry) { step.heap.push_back(entry); });
+            } else {
+                step.delta = move(pending);
+            }
+        } else {
+            step.visited.assign(visited.begin(), visited.end());
+            step.distances.assign(distances.begin(), distances.end());
+            step.previous.assign(previous.begin(), previous.end());
+            step.currentQueue.reserve(pq.size());
+            pq.forEachOrdered([&](const pair<int, int>& entry) { step.currentQueue.push_back(entry.second); });
+        }
+        if (stream) {
+            // Written and no longer read: the next step reuses its memory
+            step.writeJSON(*stream);
+            arena.rewind(streamMark);
+        } else {
+            steps.push_back(move(step));
+        }
+        pending = DijkstraDelta(arena);
     }
     
     
 public:
-    DijkstraVisualizer(const Graph& g) : graph(g), stepNum(0) {}
+    DijkstraVisualizer(const Graph& g, TraceFormat format = TRACE_FULL, bool useHeuristic = false,
+                       bool withText = false)
+        : graph(g), arena(requestArena()), streamMark(arena.mark()), steps(&arena), stepNum(0),
+          format(format), useHeuristic(useHeuristic), withText(withText), pending(arena), stream(nullptr) {}
     
     json findPath(int start, int end) {
+        json result = search(start, end);
+        result["steps"] = json::array();
+        
+        for (const auto& step : steps) {
+            result["steps"].push_back(step.toJSON());
+        }
+        return result;
+    }
+    
+    // Same response as findPath, but each step is serialized as soon as it
+    // is recorded and the summary fields follow the steps
+    void streamPath(int start, int end, JsonWriter& out) {
+        stream = &out;
+        streamMark = arena.mark();
+        out.beginObject();
+        out.key("steps");
+        out.beginArray();
+        json summary = search(start, end);
+        out.endArray();
+        out.fields(summary);
+        out.endObject();
+        stream = nullptr;
+    }
+    
+private:
+    // Run the search, recording steps, and return every response field but "steps"
+    json search(int start, int end) {
         int n = graph.size();
         vector<int> dist(n, INF);
         vector<bool> visited(n, false);
         vector<int> previous(n, -1);
+        int settled = 0;
+        if (useHeuristic) graph.lowerBoundsTo(end, lowerBounds);
         
-        // Priority queue: pair<distance, node>
-        priority_queue<pair<int, int>, vector<pair<int, int>>, greater<pair<int, int>>> pq;
+        // Queue keyed by distance, or by distance + estimate for A*;
+        // each node appears once and relaxations lower its key
+        IndexedHeap pq(n);
         
         dist[start] = 0;
-        pq.push({0, start});
+        pq.push(start, priority(start, 0));
         
         // Initial step
-        vector<int> queueViz = {start};
-        recordStep(start, 
-                  "Starting at " + graph.getNode(start).name,
-                  "Initialize distance to start node as 0, all others as infinity. "
-                  "Add start node to priority queue.",
-                  visited, dist, previous, queueViz);
+        recordStep(start, DIJKSTRA_START, -1, -1, -1, visited, dist, previous, pq);
         
 
         
         while (!pq.empty()) {
-            int u = pq.top().second;
-            int currentDist = pq.top().first;
-            pq.pop();
-            
-            if (visited[u]) continue;
+            int u = pq.pop().second;
+            pending.pops++;
             
             visited[u] = true;
-            
-            // Build current queue visualization
-            priority_queue<pair<int, int>, vector<pair<int, int>>, greater<pair<int, int>>> tempPQ = pq;
-            queueViz.clear();
-            while (!tempPQ.empty()) {
-                queueViz.push_back(tempPQ.top().second);
-                tempPQ.pop();
-            }
+            pending.visit = u;
+            settled++;
             
             // Record visit step
-            string action = "Visiting " + graph.getNode(u).name;
-            string explanation = "Selected " + graph.getNode(u).name + 
-                               " as it has the minimum distance (" + to_string(dist[u]) + 
-                               "m) among unvisited nodes. Mark it as visited.";
-            recordStep(u, action, explanation, visited, dist, previous, queueViz);
+            recordStep(u, DIJKSTRA_VISIT, -1, dist[u], useHeuristic ? lowerBounds[u] : -1,
+                       visited, dist, previous, pq);
             
             // Relax edges
-            for (int v = 0; v < n; v++) {
-                int weight = graph.getWeight(u, v);
-                if (weight > 0 && !visited[v]) {
+            for (const auto& adj : graph.neighbors(u)) {
+                int v = adj.to;
+                int weight = adj.weight;
+                if (!visited[v]) {
                     int newDist = dist[u] + weight;
                     
                     if (newDist < dist[v]) {
                         dist[v] = newDist;
                         previous[v] = u;
-                        pq.push({newDist, v});
-                        
-                        // Record relaxation step
-                        action = "Relaxing edge to " + graph.getNode(v).name;
-                        explanation = "Found shorter path to " + graph.getNode(v).name + 
-                                    " via " + graph.getNode(u).name + ". " +
-                                    "Updated distance: " + to_string(dist[v]) + "m " +
-                                    "(previous: " + to_string(currentDist + weight) + "m).";
+                        int key = priority(v, newDist);
+                        pq.push(v, key);
                         
-                        tempPQ = pq;
-                        queueViz.clear();
-                        while (!tempPQ.empty()) {
-                            queueViz.push_back(tempPQ.top().second);
-                            tempPQ.pop();
+                        if (format == TRACE_DELTA) {
+                            pending.distances.push_back({v, newDist});
+                            pending.previous.push_back({v, u});
+                            pending.pushes.push_back({key, v});
                         }
                         
-                        recordStep(u, action, explanation, visited, dist, previous, queueViz);
+                        // Record relaxation step
+                        recordStep(u, DIJKSTRA_RELAX, v, newDist, -1, visited, dist, previous, pq);
                     }
                 }
             }
             
             // If we reached the destination, we can stop
             if (u == end) {
-                recordStep(end,
-                          "Reached destination: " + graph.getNode(end).name,
-                          "Found shortest path! Total distance: " + to_string(dist[end]) + "m",
-                          visited, dist, previous, queueViz);
+                recordStep(end, DIJKSTRA_REACHED, -1, dist[end], -1, visited, dist, previous, pq);
                 break;
             }
         }
@@ -164,32 +364,53 @@ public:
         
         // Build JSON response
         json result;
-        result["algorithm"] = "dijkstra";
+        result["algorithm"] = useHeuristic ? "astar" : "dijkstra";
         result["start"] = start;
         result["end"] = end;
-        result["startName"] = graph.getNode(start).name;
-        result["endName"] = graph.getNode(end).name;
+        result["startName"] = nameOf(start);
+        result["endName"] = nameOf(end);
         result["distance"] = (dist[end] == INF) ? -1 : dist[end];
         result["path"] = path;
-        result["steps"] = json::array();
-        
-        for (const auto& step : steps) {
-            result["steps"].push_back(step.toJSON(graph));
+        result["settled"] = settled;
+        if (format == TRACE_DELTA) {
+            result["trace"] = traceFormatName(format);
+            result["keyframeInterval"] = TRACE_KEYFRAME_INTERVAL;
         }
         
         // Add complexity info
-        result["complexity"] = {
-            {"time", "O((V + E) log V)"},
-            {"space", "O(V)"},
-            {"description", "Using min-heap priority queue"}
-        };
+        if (useHeuristic) {
+            result["complexity"] = {
+                {"time", "O((V + E) log V)"},
+                {"space", "O(V)"},
+                {"description", "Indexed 4-ary heap ordered by distance + straight-line estimate, with decrease-key"}
+            };
+        } else {
+            result["complexity"] = {
+                {"time", "O((V + E) log V)"},
+                {"space", "O(V)"},
+                {"description", "Using an indexed 4-ary heap with decrease-key"}
+            };
+        }
         
         return result;
     }
 };
 
 // Main API function
-json getDijkstraPath(const Graph& g, int start, int end) {
-    DijkstraVisualizer viz(g);
+json getDijkstraPath(const Graph& g, int start, int end, TraceFormat format = TRACE_FULL, bool withText = false) {
+    DijkstraVisualizer viz(g, format, false, withText);
     return viz.findPath(start, end);
+}
+
+// A* with the same step schema as getDijkstraPath
+json getAStarPath(const Graph& g, int start, int end, TraceFormat format = TRACE_FULL, bool withText = false) {
+    DijkstraVisualizer viz(g, format, true, withText);
+    return viz.findPath(start, end);
+}
+
+// Streaming variant of getDijkstraPath / getAStarPath
+void streamDijkstraPath(const Graph& g, int start, int end, TraceFormat format, bool useHeuristic,
+                        bool withText, JsonWriter& out) {
+    DijkstraVisualizer viz(g, format, useHeuristic, withText);
+    viz.streamPath(start, end, out);
 }
\ No newline at end of file
@@ -0,0 +1,80 @@
+// Micro-benchmark for the batched distance kernel: times the scalar loop
+// against the variant the server dispatches to, at several graph sizes,
+// and checks that both give identical results.
+//   distance_bench [repeats]
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstdlib>
+
+#include "distance_kernel.hpp"
+
+using namespace std;
+
+// Best of repeats runs of f, in nanoseconds per point
+template <typename F>
+double timePerPoint(F f, size_t count, int repeats) {
+    double best = 0;
+    for (int r = 0; r < repeats; r++) {
+        auto begin = chrono::steady_clock::now();
+        f();
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count();
+        if (r == 0 || ns < best) best = ns;
+    }
+    return best / count;
+}
+
+int main(int argc, char* argv[]) {
+    int repeats = argc > 1 ? atoi(argv[1]) : 20;
+    if (repeats < 1) {
+        cerr << "Usage: " << argv[0] << " [repeats]" << endl;
+        return 1;
+    }
+
+    cout << "kernel: " << distanceKernelName() << ", best of " << repeats << " runs" << endl;
+    cout << setw(9) << "nodes" << setw(14) << "kind" << setw(13) << "scalar ns" << setw(13) << "kernel ns"
+         << setw(10) << "speedup" << endl;
+
+    mt19937_64 rng(42);
+    uniform_real_distribution<double> coordinate(0, 10000);
+    bool mismatch = false;
+
+    for (size_t count : {10000, 100000, 1000000}) {
+        vector<double> xs(count), ys(count);
+        for (size_t i = 0; i < count; i++) {
+            xs[i] = coordinate(rng);
+            ys[i] = coordinate(rng);
+        }
+        double px = coordinate(rng), py = coordinate(rng);
+
+        vector<int> scalarInts(count), kernelInts(count);
+        double scalar = timePerPoint([&] {
+            scaledDistancesScalar(xs.data(), ys.data(), count, px, py, 1.0, scalarInts.data());
+        }, count, repeats);
+        double kernel = timePerPoint([&] {
+            straightLineDistances(xs.data(), ys.data(), count, px, py, kernelInts.data());
+        }, count, repeats);
+        mismatch |= scalarInts != kernelInts;
+        cout << setw(9) << count << setw(14) << "distance" << fixed << setprecision(3) << setw(13) << scalar
+             << setw(13) << kernel << setw(9) << setprecision(2) << scalar / kernel << "x" << endl;
+
+        vector<double> scalarSquares(count), kernelSquares(count);
+        scalar = timePerPoint([&] {
+            squaredDistancesScalar(xs.data(), ys.data(), count, px, py, scalarSquares.data());
+        }, count, repeats);
+        kernel = timePerPoint([&] {
+            squaredDistances(xs.data(), ys.data(), count, px, py, kernelSquares.data());
+        }, count, repeats);
+        mismatch |= scalarSquares != kernelSquares;
+        cout << setw(9) << count << setw(14) << "squared" << setprecision(3) << setw(13) << scalar
+             << setw(13) << kernel << setw(9) << setprecision(2) << scalar / kernel << "x" << endl;
+    }
+
+    if (mismatch) {
+        cerr << "Error: kernel results differ from the scalar loop" << endl;
+        return 1;
+    }
+    return 0;
+}
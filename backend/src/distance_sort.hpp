@@ -0,0 +1,175 @@
+#pragma once
+#include "graph.hpp"
+#include "thread_pool.hpp"
+#include "distance_kernel.hpp"
+#include "../lib/json.hpp"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using json = nlohmann::json;
+using namespace std;
+
+// Full sorts of at least this many places are split across threads
+const size_t PARALLEL_SORT_MIN_ITEMS = 1 << 16;
+
+// One place to rank: sorted by distance, ties by node id
+struct RankedNode {
+    int distance;
+    int id;
+
+    bool operator<(const RankedNode& other) const {
+        return distance != other.distance ? distance < other.distance : id < other.id;
+    }
+};
+
+// Distance from the reference to every other node, in node id order.
+// networkDistances, if given, holds walking distances (INF if unreachable)
+// and replaces straight-line distance; unreachable places are left out and
+// counted in unreachable.
+vector<RankedNode> rankingCandidates(const Graph& graph, int referenceNodeId,
+                                     const vector<int>* networkDistances, int& unreachable) {
+    vector<RankedNode> items;
+    items.reserve(graph.size());
+    unreachable = 0;
+
+    if (networkDistances) {
+        for (int i = 0; i < graph.size(); i++) {
+            if (i == referenceNodeId) continue;
+            if ((*networkDistances)[i] == INF) {
+                unreachable++;
+                continue;
+            }
+            items.push_back({(*networkDistances)[i], i});
+        }
+        return items;
+    }
+
+    // Straight line: the vector kernel over the coordinate arrays, one
+    // stack-sized block at a time
+    const double* xs = graph.getXs().data();
+    const double* ys = graph.getYs().data();
+    double refX = xs[referenceNodeId], refY = ys[referenceNodeId];
+    const int BLOCK = 512;
+    int block[BLOCK];
+    for (int first = 0; first < graph.size(); first += BLOCK) {
+        int count = min(BLOCK, graph.size() - first);
+        straightLineDistances(xs + first, ys + first, count, refX, refY, block);
+        for (int j = 0; j < count; j++) {
+            if (first + j != referenceNodeId) items.push_back({block[j], first + j});
+        }
+    }
+    return items;
+}
+
+// LSD radix sort on the (non-negative) distance, 8 bits per pass, skipping
+// the passes above the largest key. Stable, so items already in id order
+// end up ordered by (distance, id). scratch is resized as needed.
+void radixSortRanked(RankedNode* first, RankedNode* last, vector<RankedNode>& scratch) {
+    size_t count = last - first;
+    if (count < 2) return;
+    scratch.resize(count);
+
+    unsigned int maxKey = 0;
+    for (RankedNode* it = first; it != last; ++it) maxKey = max(maxKey, static_cast<unsigned int>(it->distance));
+
+    RankedNode* from = first;
+    RankedNode* to = scratch.data();
+    for (int shift = 0; shift < 32 && (maxKey >> shift) != 0; shift += 8) {
+        size_t buckets[257] = {0};
+        for (size_t i = 0; i < count; i++) buckets[((from[i].distance >> shift) & 0xFF) + 1]++;
+        for (int b = 0; b < 256; b++) buckets[b + 1] += buckets[b];
+        for (size_t i = 0; i < count; i++) to[buckets[(from[i].distance >> shift) & 0xFF]++] = from[i];
+        swap(from, to);
+    }
+    if (from != first) copy(from, from + count, first);
+}
+
+// Sort the whole list. Large lists are cut into one slice per thread, the
+// slices radix sorted in parallel and then merged pairwise, also in parallel.
+// Returns the number of threads used.
+int sortRanked(vector<RankedNode>& items, int maxThreads = defaultThreadCount()) {
+    size_t count = items.size();
+    size_t slices = (count >= PARALLEL_SORT_MIN_ITEMS && maxThreads > 1) ? maxThreads : 1;
+    if (slices == 1) {
+        vector<RankedNode> scratch;
+        radixSortRanked(items.data(), items.data() + count, scratch);
+        return 1;
+    }
+
+    vector<size_t> bounds(slices + 1);
+    for (size_t s = 0; s <= slices; s++) bounds[s] = count * s / slices;
+
+    int threads = parallelFor(slices, [&](size_t s) {
+        vector<RankedNode> scratch;
+        radixSortRanked(items.data() + bounds[s], items.data() + bounds[s + 1], scratch);
+    }, maxThreads);
+
+    // Merge neighbouring runs until one is left, ping-ponging between buffers
+    vector<RankedNode> buffer(count);
+    RankedNode* from = items.data();
+    RankedNode* to = buffer.data();
+    for (size_t width = 1; width < slices; width *= 2) {
+        size_t pairs = (slices + 2 * width - 1) / (2 * width);
+        parallelFor(pairs, [&](size_t p) {
+            size_t lo = bounds[2 * width * p];
+            size_t mid = bounds[min(slices, 2 * width * p + width)];
+            size_t hi = bounds[min(slices, 2 * width * p + 2 * width)];
+            merge(from + lo, from + mid, from + mid, from + hi, to + lo);
+        }, maxThreads);
+        swap(from, to);
+    }
+    if (from != items.data()) items.swap(buffer);
+    return threads;
+}
+
+// Keep only the k closest places, in order: O(n + k log k)
+void topRanked(vector<RankedNode>& items, size_t k) {
+    if (k < items.size()) {
+        nth_element(items.begin(), items.begin() + k, items.end());
+        items.resize(k);
+    }
+    sort(items.begin(), items.end());
+}
+
+// Locations by distance from a reference without a visual trace, for
+// /api/sort?mode=fast. With k > 0 only the k closest are returned.
+json rankLocationsByDistance(const Graph& graph, int referenceNodeId, int k,
+                             const vector<int>* networkDistances = nullptr) {
+    if (k < 0) throw invalid_argument("k must not be negative");
+
+    int unreachable;
+    vector<RankedNode> items = rankingCandidates(graph, referenceNodeId, networkDistances, unreachable);
+    size_t candidates = items.size();
+
+    json result;
+    if (k > 0 && static_cast<size_t>(k) < items.size()) {
+        topRanked(items, k);
+        result["algorithm"] = "top-k";
+        result["k"] = k;
+    } else {
+        int threads = sortRanked(items);
+        result["algorithm"] = threads > 1 ? "parallel radix" : "radix";
+        if (threads > 1) result["threads"] = threads;
+    }
+
+    result["referenceNode"] = referenceNodeId;
+    result["referenceName"] = graph.getName(referenceNodeId);
+    result["candidates"] = candidates;
+    if (networkDistances) {
+        result["metric"] = "network";
+        result["unreachable"] = unreachable;
+    }
+
+    json sorted = json::array();
+    for (const auto& item : items) {
+        sorted.push_back({
+            {"id", item.id},
+            {"name", graph.getName(item.id)},
+            {"distance", item.distance}
+        });
+    }
+    result["sortedLocations"] = move(sorted);
+    return result;
+}
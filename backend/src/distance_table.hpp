@@ -0,0 +1,324 @@
+#pragma once
+#include "graph.hpp"
+#include "indexed_heap.hpp"
+#include "route.hpp"
+#include "shortest_path_tree.hpp"
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+
+// Graphs up to this size get a full all-pairs matrix, larger ones hub labels
+const int DENSE_TABLE_MAX_NODES = 2000;
+
+// Above this size preprocessing is skipped and routing falls back to search.
+// Labels grow superlinearly on grid-like networks: about 2 s at 10k nodes,
+// 10 s at 20k and over a minute at 50k. Nothing is served until the first
+// table is built; after an edge change the server rebuilds it in the
+// background.
+const int HUB_LABEL_MAX_NODES = 10000;
+
+// Precomputed shortest-path distances for constant-time route lookups.
+// Small graphs store one Dijkstra tree per source. Large graphs use pruned
+// landmark labeling: every node keeps (hub, distance, parent) entries so that
+// dist(s,t) = min over common hubs of dist(s,hub) + dist(hub,t).
+class DistanceTable {
+private:
+    enum Strategy { NONE, ALL_PAIRS, HUB_LABELS };
+
+    // One hub label entry of a node
+    struct LabelEntry {
+        int hub;      // rank of the hub in the processing order
+        int dist;     // distance from the node to the hub
+        int parent;   // next node towards the hub, -1 at the hub itself
+    };
+
+    Strategy strategy;
+    int n;
+    double buildMillis;     // last build() or update()
+    int repairedRows;
+
+    // ALL_PAIRS: the Dijkstra tree grown from each source. Copies of a
+    // table share the trees, and update() replaces only those it repairs.
+    vector<shared_ptr<const ShortestPathTree>> trees;
+
+    // HUB_LABELS: labels of node v are labels[labelOffsets[v] .. labelOffsets[v+1]),
+    // sorted by hub rank
+    vector<int> hubNode;        // rank -> node id
+    vector<int> labelOffsets;
+    vector<LabelEntry> labels;
+
+    // Full single-source tree grown from s. pq is empty on entry and on
+    // return, so one heap serves every tree.
+    shared_ptr<const ShortestPathTree> buildTree(const Graph& graph, int s, IndexedHeap& pq) {
+        auto tree = make_shared<ShortestPathTree>(n);
+        vector<bool> visited(n, false);
+
+        tree->dist[s] = 0;
+        pq.push(s, 0);
+
+        while (!pq.empty()) {
+            int u = pq.pop().second;
+            visited[u] = true;
+
+            for (const auto& adj : graph.neighbors(u)) {
+                int newDist = tree->dist[u] + adj.weight;
+                if (!visited[adj.to] && newDist < tree->dist[adj.to]) {
+                    tree->dist[adj.to] = newDist;
+                    tree->parent[adj.to] = u;
+                    pq.push(adj.to, newDist);
+                }
+            }
+        }
+        return tree;
+    }
+
+    void buildAllPairs(const Graph& graph) {
+        trees.resize(n);
+        IndexedHeap pq(n);
+        for (int s = 0; s < n; s++) {
+            trees[s] = buildTree(graph, s, pq);
+        }
+    }
+
+    void buildHubLabels(const Graph& graph) {
+        // High-degree nodes first, they cover the most shortest paths
+        hubNode.resize(n);
+        for (int v = 0; v < n; v++) hubNode[v] = v;
+        stable_sort(hubNode.begin(), hubNode.end(), [&](int a, int b) {
+            return graph.neighbors(a).size() > graph.neighbors(b).size();
+        });
+
+        vector<vector<LabelEntry>> building(n);
+        vector<int> tentative(n, INF);
+        vector<int> from(n, -1);
+        vector<int> hubDist(n, INF);   // distances in the current hub's own label, by hub rank
+        vector<int> touched;
+        IndexedHeap pq(n);   // drained by every hub's search, so shared between them
+
+        for (int rank = 0; rank < n; rank++) {
+            int h = hubNode[rank];
+            for (const auto& entry : building[h]) hubDist[entry.hub] = entry.dist;
+
+            tentative[h] = 0;
+            touched.push_back(h);
+            pq.push(h, 0);
+
+            while (!pq.empty()) {
+                pair<int, int> top = pq.pop();
+                int d = top.first;
+                int u = top.second;
+
+                // Prune if hubs already processed give a path at least as short
+                bool covered = false;
+                for (const auto& entry : building[u]) {
+                    if (hubDist[entry.hub] != INF && hubDist[entry.hub] + entry.dist <= d) {
+                        covered = true;
+                        break;
+                    }
+                }
+                if (covered) continue;
+
+                building[u].push_back({rank, d, from[u]});
+
+                for (const auto& adj : graph.neighbors(u)) {
+                    int newDist = d + adj.weight;
+                    if (newDist < tentative[adj.to]) {
+                        if (tentative[adj.to] == INF) touched.push_back(adj.to);
+                        tentative[adj.to] = newDist;
+                        from[adj.to] = u;
+                        pq.push(adj.to, newDist);
+                    }
+                }
+            }
+
+            for (int v : touched) {
+                tentative[v] = INF;
+                from[v] = -1;
+            }
+            touched.clear();
+            for (const auto& entry : building[h]) hubDist[entry.hub] = INF;
+        }
+
+        labelOffsets.assign(n + 1, 0);
+        for (int v = 0; v < n; v++) {
+            labelOffsets[v + 1] = labelOffsets[v] + building[v].size();
+        }
+        labels.clear();
+        labels.reserve(labelOffsets[n]);
+        for (int v = 0; v < n; v++) {
+            labels.insert(labels.end(), building[v].begin(), building[v].end());
+            vector<LabelEntry>().swap(building[v]);
+        }
+    }
+
+    const LabelEntry* findLabel(int v, int hub) const {
+        const LabelEntry* first = labels.data() + labelOffsets[v];
+        const LabelEntry* last = labels.data() + labelOffsets[v + 1];
+        const LabelEntry* it = lower_bound(first, last, hub,
+                                           [](const LabelEntry& e, int h) { return e.hub < h; });
+        return (it != last && it->hub == hub) ? it : nullptr;
+    }
+
+    // Best common hub of s and t, -1 if they are not connected
+    int bestHub(int s, int t, int& best) const {
+        const LabelEntry* a = labels.data() + labelOffsets[s];
+        const LabelEntry* aEnd = labels.data() + labelOffsets[s + 1];
+        const LabelEntry* b = labels.data() + labelOffsets[t];
+        const LabelEntry* bEnd = labels.data() + labelOffsets[t + 1];
+
+        best = INF;
+        int hub = -1;
+        while (a != aEnd && b != bEnd) {
+            if (a->hub < b->hub) {
+                a++;
+            } else if (a->hub > b->hub) {
+                b++;
+            } else {
+                if (a->dist + b->dist < best) {
+                    best = a->dist + b->dist;
+                    hub = a->hub;
+                }
+                a++;
+                b++;
+            }
+        }
+        return hub;
+    }
+
+    // Walk from v to the hub through the parent links of v's labels
+    void appendTowardsHub(int v, int hub, vector<int>& out) const {
+        while (v != -1) {
+            out.push_back(v);
+            v = findLabel(v, hub)->parent;
+        }
+    }
+
+public:
+    DistanceTable() : strategy(NONE), n(0), buildMillis(0), repairedRows(0) {}
+
+    // (Re)build from the current graph; call again whenever the graph changes
+    void build(const Graph& graph) {
+        auto begin = chrono::steady_clock::now();
+
+        n = graph.size();
+        trees.clear();
+        hubNode.clear();
+        labelOffsets.clear();
+        labels.clear();
+
+        if (n <= DENSE_TABLE_MAX_NODES) {
+            strategy = ALL_PAIRS;
+            buildAllPairs(graph);
+        } else if (n <= HUB_LABEL_MAX_NODES) {
+            strategy = HUB_LABELS;
+            buildHubLabels(graph);
+        } else {
+            strategy = NONE;
+        }
+        repairedRows = strategy == ALL_PAIRS ? n : 0;
+
+        buildMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+    }
+
+    // Graphs of this size get hub labels, which update() cannot repair
+    static bool usesHubLabels(int nodes) {
+        return nodes > DENSE_TABLE_MAX_NODES && nodes <= HUB_LABEL_MAX_NODES;
+    }
+
+    // True if update() can bring this table up to date with graph: an
+    // all-pairs table over the same nodes
+    bool repairable(const Graph& graph) const {
+        return strategy == ALL_PAIRS && graph.size() == n;
+    }
+
+    // Bring the table up to date with graph after a single edge change,
+    // repairing only the trees the change affects, and only their affected
+    // parts. Returns false unless repairable(graph); call build() instead.
+    bool update(const Graph& graph, const EdgeChange& change) {
+        if (!repairable(graph)) return false;
+        auto begin = chrono::steady_clock::now();
+
+        repairedRows = repairTrees(graph, trees, change);
+
+        buildMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+        return true;
+    }
+
+    // Trees grown by the last build() or changed by the last update()
+    int lastRepairedRows() const {
+        return repairedRows;
+    }
+
+    bool ready() const {
+        return strategy != NONE;
+    }
+
+    // Shortest distance, INF if unreachable
+    int distance(int s, int t) const {
+        if (strategy == ALL_PAIRS) {
+            return trees[s]->dist[t];
+        }
+        int best;
+        bestHub(s, t, best);
+        return best;
+    }
+
+    // Shortest path start..end, empty if unreachable
+    vector<int> path(int s, int t) const {
+        vector<int> result;
+        if (strategy == ALL_PAIRS) {
+            const ShortestPathTree& tree = *trees[s];
+            if (tree.dist[t] == INF) return result;
+            for (int v = t; v != -1; v = tree.parent[v]) {
+                result.push_back(v);
+            }
+            reverse(result.begin(), result.end());
+            return result;
+        }
+
+        int best;
+        int hub = bestHub(s, t, best);
+        if (hub == -1) return result;
+
+        appendTowardsHub(s, hub, result);
+        vector<int> tail;
+        appendTowardsHub(t, hub, tail);
+        result.insert(result.end(), tail.rbegin() + 1, tail.rend());
+        return result;
+    }
+
+    // Route lookup with the same result type as the search engines
+    RouteResult route(int start, int end) const {
+        RouteResult result;
+        result.start = start;
+        result.end = end;
+        int d = distance(start, end);
+        if (d != INF) {
+            result.distance = d;
+            result.path = path(start, end);
+        }
+        return result;
+    }
+
+    const char* strategyName() const {
+        switch (strategy) {
+            case ALL_PAIRS: return "all-pairs";
+            case HUB_LABELS: return "hub labels";
+            default: return "none";
+        }
+    }
+
+    double buildTimeMillis() const {
+        return buildMillis;
+    }
+
+    size_t memoryBytes() const {
+        size_t bytes = (hubNode.capacity() + labelOffsets.capacity()) * sizeof(int)
+                     + labels.capacity() * sizeof(LabelEntry);
+        for (const auto& tree : trees) bytes += tree->memoryBytes();
+        return bytes;
+    }
+};
@@ -0,0 +1,231 @@
+#pragma once
+#include "graph.hpp"
+#include "route.hpp"
+#include "indexed_heap.hpp"
+#include "search_workspace.hpp"
+#include "shortest_path_tree.hpp"
+#include "../lib/json.hpp"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+
+using json = nlohmann::json;
+using namespace std;
+
+// Most facilities one nearest-facility query may return
+const int MAX_FACILITY_RESULTS = 100;
+
+// The per-type table keeps (types x nodes) entries; above this it is skipped
+const size_t FACILITY_TABLE_MAX_ENTRIES = 4000000;
+
+// Up to k nodes of the given type closest to source by walking distance,
+// nearest first, from one Dijkstra that stops once k of them are settled.
+// settled receives the node count of the whole search.
+vector<RouteResult> nearestFacilities(const Graph& graph, int source, const string& type, int k, int& settled) {
+    checkNodeId(graph, source);
+
+    vector<int> found;
+    settled = 0;
+    int typeCode = graph.findTypeCode(type);
+    if (typeCode < 0) return {};   // the type does not occur: nothing to search for
+
+    SearchWorkspace& ws = threadWorkspace();
+    ws.begin(graph.size());
+    IndexedHeap& pq = ws.heap;
+    ws.reach(source, 0, -1);
+    pq.push(source, 0);
+
+    while (!pq.empty() && (int)found.size() < k) {
+        int u = pq.pop().second;
+        ws.settle(u);
+        settled++;
+        if (graph.getTypeCode(u) == typeCode) found.push_back(u);
+
+        int distU = ws.distance(u);
+        for (const auto& adj : graph.neighbors(u)) {
+            int newDist = distU + adj.weight;
+            if (!ws.settled(adj.to) && newDist < ws.distance(adj.to)) {
+                ws.reach(adj.to, newDist, u);
+                pq.push(adj.to, newDist);
+            }
+        }
+    }
+
+    vector<RouteResult> results(found.size());
+    for (size_t i = 0; i < found.size(); i++) {
+        results[i].start = source;
+        results[i].end = found[i];
+        results[i].distance = ws.distance(found[i]);
+        results[i].path = ws.path(source, found[i]);
+    }
+    return results;
+}
+
+// Walking distance from every node to the nearest node of each type, from
+// one multi-source Dijkstra per type seeded with all of its nodes. Answers
+// "nearest food from here" with a lookup and a walk along the parent links.
+class FacilityTable {
+private:
+    int n;
+    int types;              // one forest per node type code of the graph
+    // Forest t: distance to the nearest node of type code t and the next node
+    // towards it. Copies of a table share the forests, and update() replaces
+    // only those it repairs.
+    vector<shared_ptr<const ShortestPathTree>> forests;
+    double buildMillis;     // last build() or update()
+    int repairedForests;
+
+    shared_ptr<const ShortestPathTree> buildForest(const Graph& graph, int t, IndexedHeap& pq) {
+        auto forest = make_shared<ShortestPathTree>(n);
+        vector<bool> visited(n, false);
+
+        for (int v = 0; v < n; v++) {
+            if (graph.getTypeCode(v) == t) {
+                forest->dist[v] = 0;
+                pq.push(v, 0);
+            }
+        }
+
+        while (!pq.empty()) {
+            int u = pq.pop().second;
+            visited[u] = true;
+
+            for (const auto& adj : graph.neighbors(u)) {
+                int newDist = forest->dist[u] + adj.weight;
+                if (!visited[adj.to] && newDist < forest->dist[adj.to]) {
+                    forest->dist[adj.to] = newDist;
+                    forest->parent[adj.to] = u;
+                    pq.push(adj.to, newDist);
+                }
+            }
+        }
+        return forest;
+    }
+
+public:
+    FacilityTable() : n(0), types(0), buildMillis(0), repairedForests(0) {}
+
+    // (Re)build from the current graph; call again whenever the graph changes.
+    // Left empty if every type together would exceed FACILITY_TABLE_MAX_ENTRIES.
+    void build(const Graph& graph) {
+        auto begin = chrono::steady_clock::now();
+
+        n = graph.size();
+        forests.clear();
+        types = graph.getTypeCount();
+
+        if ((size_t)types * n <= FACILITY_TABLE_MAX_ENTRIES) {
+            forests.resize(types);
+            IndexedHeap pq(n);
+            for (int t = 0; t < types; t++) {
+                forests[t] = buildForest(graph, t, pq);
+            }
+        } else {
+            types = 0;
+        }
+        repairedForests = types;
+
+        buildMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+    }
+
+    // Bring the table up to date with graph after a single edge change,
+    // repairing only the forests it affects. Returns false if the table is
+    // empty or graph has other nodes or types; call build() instead.
+    bool update(const Graph& graph, const EdgeChange& change) {
+        if (!ready() || graph.size() != n || graph.getTypeCount() != types) return false;
+        auto begin = chrono::steady_clock::now();
+
+        repairedForests = repairTrees(graph, forests, change);
+
+        buildMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+        return true;
+    }
+
+    // Forests grown by the last build() or changed by the last update()
+    int lastRepairedForests() const {
+        return repairedForests;
+    }
+
+    bool ready() const {
+        return types > 0;
+    }
+
+    // Nearest node of type from source, as a route; distance -1 if none is
+    // reachable or the type does not occur in the graph
+    RouteResult nearest(const Graph& graph, int source, const string& type) const {
+        RouteResult result;
+        result.start = source;
+
+        int code = graph.findTypeCode(type);
+        if (code < 0 || code >= types) return result;
+        const ShortestPathTree& forest = *forests[code];
+        if (forest.dist[source] == INF) return result;
+
+        result.distance = forest.dist[source];
+        for (int v = source; v != -1; v = forest.parent[v]) {
+            result.path.push_back(v);
+        }
+        result.end = result.path.back();
+        return result;
+    }
+
+    double buildTimeMillis() const {
+        return buildMillis;
+    }
+
+    size_t memoryBytes() const {
+        size_t bytes = 0;
+        for (const auto& forest : forests) bytes += forest->memoryBytes();
+        return bytes;
+    }
+};
+
+// Response for /api/nearest/facility. The table answers k=1 unless
+// algorithm=dijkstra; larger k always search.
+json nearestFacilityResponse(const Graph& graph, const FacilityTable& table, int source,
+                             const string& type, int k, const string& algorithm) {
+    checkNodeId(graph, source);
+    if (type.empty()) throw invalid_argument("type is required");
+    if (k < 1 || k > MAX_FACILITY_RESULTS) {
+        throw invalid_argument("k must be between 1 and " + to_string(MAX_FACILITY_RESULTS));
+    }
+    if (!algorithm.empty() && algorithm != "table" && algorithm != "dijkstra") {
+        throw invalid_argument("Unknown algorithm: " + algorithm);
+    }
+    bool useTable = (algorithm == "table") || (algorithm.empty() && k == 1 && table.ready());
+    if (useTable && !table.ready()) throw Unavailable("Facility table is not available");
+    if (useTable && k != 1) throw invalid_argument("The facility table only answers k=1");
+
+    vector<RouteResult> found;
+    int settled = 0;
+    if (useTable) {
+        RouteResult match = table.nearest(graph, source, type);
+        if (match.distance != -1) found.push_back(match);
+    } else {
+        found = nearestFacilities(graph, source, type, k, settled);
+    }
+
+    json facilities = json::array();
+    for (const auto& match : found) {
+        facilities.push_back({
+            {"id", match.end},
+            {"name", graph.getName(match.end)},
+            {"distance", match.distance},
+            {"path", match.path}
+        });
+    }
+
+    json result;
+    result["algorithm"] = useTable ? "table" : "dijkstra";
+    result["source"] = source;
+    result["type"] = type;
+    result["k"] = k;
+    result["facilities"] = facilities;
+    if (!useTable) {
+        result["settled"] = settled;
+    }
+    return result;
+}
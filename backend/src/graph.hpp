@@ -1,95 +1,389 @@
 #pragma once
 #include <vector>
 #include <string>
-#include <map>
 #include <limits>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <stdexcept>
+#include "distance_kernel.hpp"
 
 using namespace std;
 
 const int INF= numeric_limits<int>::max();
 
-//Node= a location on campus
+//Node types are stored as 16-bit codes
+const int MAX_NODE_TYPE_CODE= numeric_limits<uint16_t>::max();
+
+//Node= a location on campus, as a lightweight view into the graph's
+//arrays; it stays valid until the next node is added
 struct Node{
     int id;
-    string name;
+    string_view name;
     double x,y; //coordinates for the location
-    string type; //"building","parking","food","leisure"
-
-    Node(): id(0), x(0), y(0) {}
-    Node(int id, string name, double x, double y, string type="building")
-    : id(id), name(name), x(x), y(y), type(type){}
+    string_view type; //"building","parking","food","leisure"
 };
 
 //Edge= a path between two locations
 struct Edge{
     int from, to;
     int weight; //distance in meters
-    string pathType;//"walkway","road","stairs"
+    int pathType; //code in the graph's path type table: "walkway","road","stairs"
+};
+
+//SymbolTable= small set of interned strings, each coded by its index
+class SymbolTable{
+    private:
+    vector<string> symbols;
+    unordered_map<string, int> codes;
+
+    public:
+    int intern(const string& s){
+        auto it = codes.find(s);
+        if(it != codes.end()) return it->second;
+        symbols.push_back(s);
+        codes.emplace(s, (int)symbols.size() - 1);
+        return (int)symbols.size() - 1;
+    }
+
+    //Code of s, -1 if it was never interned
+    int find(string_view s) const{
+        auto it = codes.find(string(s));
+        return (it != codes.end()) ? it->second : -1;
+    }
+
+    const string& name(int code) const { return symbols[code]; }
+    int size() const { return symbols.size(); }
+};
+
+//StringPool= many strings packed back to back in one buffer
+class StringPool{
+    private:
+    string chars;
+    vector<uint32_t> offsets{0}; //string i is chars[offsets[i] .. offsets[i+1])
+
+    public:
+    void add(string_view s){
+        chars.append(s.data(), s.size());
+        offsets.push_back(chars.size());
+    }
+
+    string_view get(int i) const{
+        return string_view(chars.data() + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+
+    void reserve(size_t count){ offsets.reserve(count + 1); }
+    size_t bytes() const { return chars.capacity() + offsets.capacity() * sizeof(uint32_t); }
+};
+
+//Lowercase copy of a name, for case-insensitive lookups
+string foldCase(const string& s){
+    string folded = s;
+    for(auto& c : folded){
+        if(c >= 'A' && c <= 'Z') c += 'a' - 'A';
+    }
+    return folded;
+}
 
-    Edge(int f, int t, int w, string pt="walkway")
-    :from(f), to(t), weight(w), pathType(pt){}
+//Adjacency= one packed (neighbor, weight) entry of the CSR store
+struct Adjacency{
+    int to;
+    int weight;
+};
+
+//NeighborSpan= read-only view over one CSR row, no allocation
+struct NeighborSpan{
+    const Adjacency* first;
+    const Adjacency* last;
+
+    const Adjacency* begin() const { return first; }
+    const Adjacency* end() const { return last; }
+    int size() const { return static_cast<int>(last - first); }
+    bool empty() const { return first == last; }
 };
 
 //Graph class
 class Graph{
     private:
-    vector<Node> nodes;
-    vector<vector<int>> adjMatrix;
+    // Node attributes as parallel arrays, so scans over coordinates or
+    // types touch only the array they need
+    vector<double> xs, ys;
+    vector<uint16_t> nodeTypes;     // codes in nodeTypeNames
+    StringPool names;
+    SymbolTable nodeTypeNames;
+    SymbolTable pathTypeNames;
     vector<Edge> edges;
-    map<string, int> nameToId;
+
+    // Compressed sparse row adjacency: the neighbors of u are
+    // adjList[adjOffsets[u] .. adjOffsets[u+1]), sorted by neighbor id
+    vector<int> adjOffsets;
+    vector<Adjacency> adjList;
+
+    // Lowest edge weight per unit of straight-line distance, so that
+    // heuristicScale * euclidean(u,v) never overestimates a walk from u to v
+    double heuristicScale;
+
+    // Node ids sorted by name, and (lowercase name, id) pairs sorted by name
+    vector<int> nameOrder;
+    vector<pair<string, int>> foldedNames;
 
     public:
-    Graph(int size){
-        adjMatrix.resize(size, vector<int>(size,0));
-        nodes.reserve(size);
+    Graph(int size): heuristicScale(0){
+        xs.reserve(size);
+        ys.reserve(size);
+        nodeTypes.reserve(size);
+        names.reserve(size);
+        edges.reserve(size);
     }
 
-    void addNode(int id, string name, double x, double y, string type="building"){
-        nodes.push_back(Node(id, name, x, y, type));
-        nameToId[name]= id;
+    // Ids are dense: id must be the number of nodes added before this one.
+    // Loaders map file ids to these first (see NodeIdMap).
+    void addNode(int id, const string& name, double x, double y, const string& type="building"){
+        if(id != size()){
+            throw invalid_argument("Node id " + to_string(id) + " out of order, expected " + to_string(size()));
+        }
+        if(nodeTypeNames.find(type) < 0 && nodeTypeNames.size() > MAX_NODE_TYPE_CODE){
+            throw invalid_argument("More than " + to_string(MAX_NODE_TYPE_CODE + 1) + " node types");
+        }
+        xs.push_back(x);
+        ys.push_back(y);
+        nodeTypes.push_back(nodeTypeNames.intern(type));
+        names.add(name);
     }
 
-    void addEdge(int from, int to, int weight, string pathType="walkway"){
-        if(from >= 0 && from < (int)nodes.size() && to >= 0 && to < (int)nodes.size()){
-            adjMatrix[from][to] = weight;
-            adjMatrix[to][from] = weight;
-            edges.push_back(Edge(from, to, weight, pathType));
+    void addEdge(int from, int to, int weight, const string& pathType="walkway"){
+        if(from >= 0 && from < size() && to >= 0 && to < size()){
+            edges.push_back({from, to, weight, pathTypeNames.intern(pathType)});
         }
     }
 
-    int getNodeId(const string& name) const{
-        auto it = nameToId.find(name);
-        return (it != nameToId.end()) ? it->second : -1;
+    // Remove every edge between two nodes, in either direction.
+    // False if there was none. Call buildAdjacency() afterwards.
+    bool removeEdge(int from, int to){
+        size_t before = edges.size();
+        edges.erase(remove_if(edges.begin(), edges.end(), [&](const Edge& e){
+            return (e.from == from && e.to == to) || (e.from == to && e.to == from);
+        }), edges.end());
+        return edges.size() != before;
     }
 
-    const Node& getNode(int id) const {
-        return nodes[id];
+    // Change the weight of every edge between two nodes.
+    // False if there was none. Call buildAdjacency() afterwards.
+    bool setEdgeWeight(int from, int to, int weight){
+        bool found = false;
+        for(auto& e : edges){
+            if((e.from == from && e.to == to) || (e.from == to && e.to == from)){
+                e.weight = weight;
+                found = true;
+            }
+        }
+        return found;
     }
 
+    // Build the CSR arrays from the edge list. Call after the edges are
+    // added or changed. A repeated (from,to) pair keeps the last weight added and
+    // non-positive weights are treated as "no edge", same as the old matrix.
+    void buildAdjacency(){
+        int n = size();
+        vector<int> degree(n + 1, 0);
+        for(const auto& e : edges){
+            degree[e.from]++;
+            degree[e.to]++;
+        }
+
+        vector<int> offsets(n + 1, 0);
+        for(int u = 0; u < n; u++){
+            offsets[u + 1] = offsets[u] + degree[u];
+        }
+
+        vector<Adjacency> packed(offsets[n]);
+        vector<int> fill(offsets.begin(), offsets.end() - 1);
+        for(const auto& e : edges){
+            packed[fill[e.from]++] = {e.to, e.weight};
+            packed[fill[e.to]++] = {e.from, e.weight};
+        }
+
+        adjOffsets.assign(n + 1, 0);
+        adjList.clear();
+        adjList.reserve(packed.size());
+        for(int u = 0; u < n; u++){
+            auto rowBegin = packed.begin() + offsets[u];
+            auto rowEnd = packed.begin() + offsets[u + 1];
+            stable_sort(rowBegin, rowEnd,
+                        [](const Adjacency& a, const Adjacency& b){ return a.to < b.to; });
+
+            for(auto it = rowBegin; it != rowEnd; ++it){
+                // Later duplicates overwrite earlier ones
+                if(next(it) != rowEnd && next(it)->to == it->to) continue;
+                if(it->weight > 0) adjList.push_back(*it);
+            }
+            adjOffsets[u + 1] = adjList.size();
+        }
+        adjList.shrink_to_fit();
+
+        heuristicScale = 0;
+        bool first = true;
+        for(const auto& e : edges){
+            double length = hypot(xs[e.from] - xs[e.to], ys[e.from] - ys[e.to]);
+            if(e.weight <= 0 || length <= 0) continue;
+            double ratio = e.weight / length;
+            if(first || ratio < heuristicScale){
+                heuristicScale = ratio;
+                first = false;
+            }
+        }
+        // Guard against rounding making the bound slightly too large
+        heuristicScale *= 1 - 1e-9;
+    }
+
+    // Sorted name indexes used by the search endpoints
+    void buildNameIndex(){
+        nameOrder.resize(size());
+        for(int i = 0; i < size(); i++) nameOrder[i] = i;
+        sort(nameOrder.begin(), nameOrder.end(),
+             [this](int a, int b){ return names.get(a) < names.get(b); });
+
+        foldedNames.clear();
+        foldedNames.reserve(size());
+        for(int i = 0; i < size(); i++){
+            foldedNames.push_back({foldCase(string(names.get(i))), i});
+        }
+        sort(foldedNames.begin(), foldedNames.end());
+    }
+
+    // Build every derived structure. Call once the nodes and edges are in.
+    void buildIndexes(){
+        buildAdjacency();
+        buildNameIndex();
+    }
+
+    // Install derived structures saved from an identical graph instead of
+    // rebuilding them, for snapshot loading. foldedOrder lists node ids in
+    // lowercase name order.
+    void restoreIndexes(vector<int> offsets, vector<Adjacency> list, double scale,
+                        vector<int> order, const vector<int>& foldedOrder){
+        adjOffsets = move(offsets);
+        adjList = move(list);
+        heuristicScale = scale;
+        nameOrder = move(order);
+
+        foldedNames.clear();
+        foldedNames.reserve(foldedOrder.size());
+        for(int id : foldedOrder){
+            foldedNames.push_back({foldCase(string(names.get(id))), id});
+        }
+    }
+
+    // Admissible and consistent lower bound on the walking distance between
+    // two nodes, for A*. Rounded down so it stays consistent with int weights.
+    int distanceLowerBound(int from, int to) const {
+        double dx = xs[from] - xs[to];
+        double dy = ys[from] - ys[to];
+        return static_cast<int>(heuristicScale * sqrt(dx * dx + dy * dy));
+    }
+
+    // distanceLowerBound(v, to) for every node v at once, through the vector kernel
+    void lowerBoundsTo(int to, vector<int>& bounds) const{
+        bounds.resize(xs.size());
+        scaledDistances(xs.data(), ys.data(), xs.size(), xs[to], ys[to], heuristicScale, bounds.data());
+    }
+
+    Node getNode(int id) const {
+        return {id, names.get(id), xs[id], ys[id], nodeTypeNames.name(nodeTypes[id])};
+    }
+
+    string_view getName(int id) const {
+        return names.get(id);
+    }
+
+    // Node type as a code into the node type table
+    int getTypeCode(int id) const {
+        return nodeTypes[id];
+    }
+
+    // Number of node type codes, 0 .. getTypeCount()-1
+    int getTypeCount() const {
+        return nodeTypeNames.size();
+    }
+
+    // Code of a node type, -1 if no node has it
+    int findTypeCode(string_view type) const {
+        return nodeTypeNames.find(type);
+    }
+
+    // Neighbors of a node as a span into the CSR arrays
+    NeighborSpan neighbors(int nodeId) const {
+        const Adjacency* base = adjList.data();
+        if(adjOffsets.empty()) return {base, base};
+        return {base + adjOffsets[nodeId], base + adjOffsets[nodeId + 1]};
+    }
+
+    // Weight of the edge between two nodes, 0 if they are not connected
     int getWeight(int from, int to) const {
-        return adjMatrix[from][to];
+        NeighborSpan row = neighbors(from);
+        const Adjacency* it = lower_bound(row.begin(), row.end(), to,
+                                          [](const Adjacency& a, int id){ return a.to < id; });
+        return (it != row.end() && it->to == to) ? it->weight : 0;
     }
 
     int size() const {
-        return nodes.size();
+        return xs.size();
+    }
+
+    // Coordinate arrays indexed by node id
+    const vector<double>& getXs() const {
+        return xs;
     }
 
-    const vector<Node>& getNodes() const {
-        return nodes;
+    const vector<double>& getYs() const {
+        return ys;
     }
 
     const vector<Edge>& getEdges() const{
         return edges;
     }
 
+    const string& getPathTypeName(int code) const{
+        return pathTypeNames.name(code);
+    }
+
+    // Bytes held by the node arrays and string pools (not the indexes)
+    size_t nodeStorageBytes() const{
+        return (xs.capacity() + ys.capacity()) * sizeof(double) + nodeTypes.capacity() * sizeof(uint16_t) +
+               names.bytes();
+    }
+
+    // The CSR arrays and heuristic scale, for saving snapshots
+    const vector<int>& getAdjOffsets() const{
+        return adjOffsets;
+    }
+
+    const vector<Adjacency>& getAdjList() const{
+        return adjList;
+    }
+
+    double getHeuristicScale() const{
+        return heuristicScale;
+    }
+
+    // Node ids in name order, for binary search
+    const vector<int>& getNameOrder() const{
+        return nameOrder;
+    }
+
+    // (lowercase name, id) sorted by lowercase name, for prefix lookups
+    const vector<pair<string, int>>& getFoldedNames() const{
+        return foldedNames;
+    }
+
     vector<int> getNeighbors(int nodeId) const{
-        vector<int> neighbors;
-        for(size_t i=0; i< nodes.size(); i++){
-            if(adjMatrix[nodeId][i]>0){
-                neighbors.push_back(i);
-            }
+        vector<int> result;
+        for(const auto& adj : neighbors(nodeId)){
+            result.push_back(adj.to);
         }
-        return neighbors;
+        return result;
     }
 };
 
@@ -124,6 +418,8 @@ Graph createCampusGraph(){
     g.addEdge(6, 8, 180, "walkway"); // Parking Lot to Garden
     g.addEdge(8, 9, 120, "walkway"); // Garden to Lab
     g.addEdge(7, 9, 400, "road"); // Ground to lab
+
+    g.buildIndexes();
     
     return g;
 }
\ No newline at end of file
@@ -0,0 +1,42 @@
+// Converts campus graphs between formats, e.g. an OSM extract into a binary
+// snapshot that the server can map at startup:
+//   graph_convert campus.osm campus.cgs
+//   campus_server --graph campus.cgs
+// or writes a synthetic campus of the given size, for load tests:
+//   graph_convert --synthetic 100000 campus.cgs
+#include <iostream>
+#include <chrono>
+
+#include "graph.hpp"
+#include "graph_io.hpp"
+#include "synthetic_graph.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    bool synthetic = argc == 4 && string(argv[1]) == "--synthetic";
+    if (argc != 3 && !synthetic) {
+        cerr << "Usage: " << argv[0] << " <input.json|.csv|.osm|.cgs> <output.json|.cgs>" << endl;
+        cerr << "       " << argv[0] << " --synthetic <nodes> <output.json|.cgs>" << endl;
+        return 1;
+    }
+    const char* input = synthetic ? "synthetic" : argv[1];
+    const char* output = argv[argc - 1];
+
+    try {
+        auto begin = chrono::steady_clock::now();
+        Graph g = synthetic ? createSyntheticCampus(stoi(argv[2])) : loadGraph(input);
+        auto loaded = chrono::steady_clock::now();
+        saveGraph(g, output);
+        auto saved = chrono::steady_clock::now();
+
+        cout << input << ": " << g.size() << " nodes, " << g.getEdges().size() << " edges, loaded in "
+             << chrono::duration<double, milli>(loaded - begin).count() << " ms" << endl;
+        cout << output << ": written in " << chrono::duration<double, milli>(saved - loaded).count() << " ms" << endl;
+    }
+    catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
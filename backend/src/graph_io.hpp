@@ -0,0 +1,608 @@
+#pragma once
+#include "graph.hpp"
+#include "../lib/json.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using json = nlohmann::json;
+using namespace std;
+
+// Graph file formats understood by loadGraph, chosen by file extension:
+//   .json  same shape as /api/graph: {"nodes":[{id,name,x,y,type}], "edges":[{from,to,weight,type}]}
+//   .csv   one record per line: "node,id,name,x,y[,type]" or "edge,from,to[,weight][,type]"
+//   .osm   OpenStreetMap XML extract; highway ways become edges
+//   .cgs   binary snapshot written by saveGraphSnapshot, loaded with mmap
+// Node ids in text files may be any integers, they are renumbered 0..n-1 in
+// file order. A missing or zero edge weight is the straight-line length.
+
+string readTextFile(const string& path) {
+    ifstream in(path, ios::binary);
+    if (!in) throw runtime_error("Cannot open " + path);
+    ostringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+bool hasExtension(const string& path, const string& extension) {
+    return path.size() >= extension.size() &&
+           foldCase(path.substr(path.size() - extension.size())) == extension;
+}
+
+// Straight-line length of an edge, at least 1
+int straightLineWeight(const Graph& g, int from, int to) {
+    const vector<double>& xs = g.getXs();
+    const vector<double>& ys = g.getYs();
+    return max(1, static_cast<int>(lround(hypot(xs[from] - xs[to], ys[from] - ys[to]))));
+}
+
+// Maps the ids used in a file to dense graph ids
+class NodeIdMap {
+private:
+    unordered_map<long long, int> ids;
+
+public:
+    int add(long long fileId, int graphId) {
+        if (!ids.emplace(fileId, graphId).second) {
+            throw runtime_error("Duplicate node id " + to_string(fileId));
+        }
+        return graphId;
+    }
+
+    int at(long long fileId) const {
+        auto it = ids.find(fileId);
+        if (it == ids.end()) throw runtime_error("Edge references unknown node " + to_string(fileId));
+        return it->second;
+    }
+};
+
+// ---------- JSON ----------
+
+Graph loadGraphJSON(const string& path) {
+    json data = json::parse(readTextFile(path));
+    const json& nodes = data.at("nodes");
+    const json& edges = data.at("edges");
+
+    Graph g(nodes.size());
+    NodeIdMap ids;
+    for (const auto& node : nodes) {
+        int id = ids.add(node.at("id").get<long long>(), g.size());
+        g.addNode(id, node.at("name").get<string>(), node.at("x").get<double>(), node.at("y").get<double>(),
+                  node.value("type", string("building")));
+    }
+    for (const auto& edge : edges) {
+        int from = ids.at(edge.at("from").get<long long>());
+        int to = ids.at(edge.at("to").get<long long>());
+        int weight = edge.value("weight", 0);
+        if (weight < 0) {
+            throw runtime_error("Edge " + edge.at("from").dump() + "-" + edge.at("to").dump() + " has a negative weight");
+        }
+        if (weight == 0) weight = straightLineWeight(g, from, to);
+        g.addEdge(from, to, weight, edge.value("type", string("walkway")));
+    }
+    g.buildIndexes();
+    return g;
+}
+
+// ---------- CSV ----------
+
+// Split one CSV line; fields may be double-quoted with "" as an escaped quote
+vector<string> splitCSVLine(const string& line) {
+    vector<string> fields(1);
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); i++) {
+        char c = line[i];
+        if (quoted) {
+            if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+                fields.back() += '"';
+                i++;
+            } else if (c == '"') {
+                quoted = false;
+            } else {
+                fields.back() += c;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            fields.emplace_back();
+        } else if (c != '\r') {
+            fields.back() += c;
+        }
+    }
+    return fields;
+}
+
+Graph loadGraphCSV(const string& path) {
+    ifstream in(path);
+    if (!in) throw runtime_error("Cannot open " + path);
+
+    // Nodes first, so that edges may appear anywhere in the file
+    vector<vector<string>> nodeRows, edgeRows;
+    string line;
+    int lineNumber = 0;
+    while (getline(in, line)) {
+        lineNumber++;
+        string trimmed = line;
+        trimmed.erase(0, trimmed.find_first_not_of(" \t"));
+        if (trimmed.empty() || trimmed[0] == '#' || trimmed[0] == '\r') continue;
+
+        vector<string> fields = splitCSVLine(trimmed);
+        if (fields[0] == "node" && fields.size() >= 5) {
+            nodeRows.push_back(move(fields));
+        } else if (fields[0] == "edge" && fields.size() >= 3) {
+            edgeRows.push_back(move(fields));
+        } else if (fields[0] != "kind") {   // optional header row
+            throw runtime_error(path + ":" + to_string(lineNumber) + ": unrecognized record");
+        }
+    }
+
+    Graph g(nodeRows.size());
+    NodeIdMap ids;
+    for (const auto& f : nodeRows) {
+        int id = ids.add(stoll(f[1]), g.size());
+        g.addNode(id, f[2], stod(f[3]), stod(f[4]), (f.size() > 5 && !f[5].empty()) ? f[5] : "building");
+    }
+    for (const auto& f : edgeRows) {
+        int from = ids.at(stoll(f[1]));
+        int to = ids.at(stoll(f[2]));
+        int weight = (f.size() > 3 && !f[3].empty()) ? stoi(f[3]) : 0;
+        if (weight < 0) throw runtime_error("Edge " + f[1] + "-" + f[2] + " has a negative weight");
+        if (weight == 0) weight = straightLineWeight(g, from, to);
+        g.addEdge(from, to, weight, (f.size() > 4 && !f[4].empty()) ? f[4] : "walkway");
+    }
+    g.buildIndexes();
+    return g;
+}
+
+// ---------- OpenStreetMap XML ----------
+
+// Replace the five predefined XML entities
+string decodeXmlEntities(string_view s) {
+    string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] == '&') {
+            string_view rest = s.substr(i);
+            if (rest.substr(0, 5) == "&amp;") { out += '&'; i += 4; continue; }
+            if (rest.substr(0, 4) == "&lt;") { out += '<'; i += 3; continue; }
+            if (rest.substr(0, 4) == "&gt;") { out += '>'; i += 3; continue; }
+            if (rest.substr(0, 6) == "&quot;") { out += '"'; i += 5; continue; }
+            if (rest.substr(0, 6) == "&apos;") { out += '\''; i += 5; continue; }
+        }
+        out += s[i];
+    }
+    return out;
+}
+
+// Value of attribute name in an XML start tag, empty if absent
+string xmlAttribute(string_view tag, string_view name) {
+    size_t pos = 0;
+    while ((pos = tag.find(name, pos)) != string_view::npos) {
+        size_t eq = pos + name.size();
+        bool wordStart = pos > 0 && (tag[pos - 1] == ' ' || tag[pos - 1] == '\t' || tag[pos - 1] == '\n');
+        if (wordStart && eq + 1 < tag.size() && tag[eq] == '=' && (tag[eq + 1] == '"' || tag[eq + 1] == '\'')) {
+            char quote = tag[eq + 1];
+            size_t close = tag.find(quote, eq + 2);
+            if (close == string_view::npos) return "";
+            return decodeXmlEntities(tag.substr(eq + 2, close - eq - 2));
+        }
+        pos = eq;
+    }
+    return "";
+}
+
+// Path type for an OSM highway=* value
+string osmPathType(const string& highway) {
+    if (highway == "steps") return "stairs";
+    if (highway == "footway" || highway == "path" || highway == "pedestrian" ||
+        highway == "corridor" || highway == "cycleway" || highway == "living_street") return "walkway";
+    return "road";
+}
+
+const double DEGREES_TO_RADIANS = 3.14159265358979323846 / 180.0;
+
+// Great-circle distance in meters
+double haversineMeters(double lat1, double lon1, double lat2, double lon2) {
+    const double R = 6371000.0;
+    const double toRad = DEGREES_TO_RADIANS;
+    double dLat = (lat2 - lat1) * toRad;
+    double dLon = (lon2 - lon1) * toRad;
+    double a = sin(dLat / 2) * sin(dLat / 2) +
+               cos(lat1 * toRad) * cos(lat2 * toRad) * sin(dLon / 2) * sin(dLon / 2);
+    return 2 * R * asin(sqrt(a));
+}
+
+// Nodes on highway ways become graph nodes, consecutive way nodes become
+// edges weighted by their great-circle distance. Coordinates are projected to
+// meters with north up. Named nodes keep their name and amenity/building type,
+// others are called "node <osm id>" with type "junction". Points of interest
+// that are not on a way are skipped.
+Graph loadGraphOSM(const string& path) {
+    struct OsmNode {
+        double lat, lon;
+        string name, type;
+    };
+    struct OsmWay {
+        vector<long long> refs;
+        string highway;
+    };
+
+    string xml = readTextFile(path);
+    unordered_map<long long, OsmNode> osmNodes;
+    vector<OsmWay> ways;
+
+    OsmNode* currentNode = nullptr;
+    OsmWay* currentWay = nullptr;
+    OsmWay way;
+    size_t pos = 0;
+    while ((pos = xml.find('<', pos)) != string::npos) {
+        size_t end = xml.find('>', pos);
+        if (end == string::npos) break;
+        string_view tag(xml.data() + pos, end - pos + 1);
+        pos = end + 1;
+        bool selfClosing = tag.size() >= 2 && tag[tag.size() - 2] == '/';
+
+        if (tag.substr(0, 6) == "<node " || tag.substr(0, 6) == "<node\t") {
+            long long id = stoll(xmlAttribute(tag, "id"));
+            OsmNode& node = osmNodes[id];
+            node.lat = stod(xmlAttribute(tag, "lat"));
+            node.lon = stod(xmlAttribute(tag, "lon"));
+            currentNode = selfClosing ? nullptr : &node;
+        } else if (tag.substr(0, 7) == "</node>") {
+            currentNode = nullptr;
+        } else if (tag.substr(0, 5) == "<way " || tag.substr(0, 5) == "<way>") {
+            way = OsmWay();
+            currentWay = selfClosing ? nullptr : &way;
+        } else if (tag.substr(0, 6) == "</way>") {
+            if (currentWay && !currentWay->highway.empty() && currentWay->refs.size() >= 2) {
+                ways.push_back(move(way));
+            }
+            currentWay = nullptr;
+        } else if (tag.substr(0, 4) == "<nd " && currentWay) {
+            currentWay->refs.push_back(stoll(xmlAttribute(tag, "ref")));
+        } else if (tag.substr(0, 5) == "<tag ") {
+            string k = xmlAttribute(tag, "k");
+            if (currentWay) {
+                if (k == "highway") currentWay->highway = xmlAttribute(tag, "v");
+            } else if (currentNode) {
+                if (k == "name") currentNode->name = xmlAttribute(tag, "v");
+                else if (k == "amenity" || (k == "building" && currentNode->type.empty())) {
+                    currentNode->type = xmlAttribute(tag, "v");
+                }
+            }
+        }
+    }
+
+    // Keep way nodes with known coordinates, in order of first use
+    vector<long long> used;
+    unordered_map<long long, int> ids;
+    double minLat = 90, maxLat = -90, minLon = 180;
+    for (const auto& w : ways) {
+        for (long long ref : w.refs) {
+            auto node = osmNodes.find(ref);
+            if (node == osmNodes.end() || ids.count(ref)) continue;
+            ids[ref] = used.size();
+            used.push_back(ref);
+            minLat = min(minLat, node->second.lat);
+            maxLat = max(maxLat, node->second.lat);
+            minLon = min(minLon, node->second.lon);
+        }
+    }
+
+    Graph g(used.size());
+    double metersPerLon = 111320.0 * cos((minLat + maxLat) / 2 * DEGREES_TO_RADIANS);
+    const double metersPerLat = 110540.0;
+    for (size_t i = 0; i < used.size(); i++) {
+        const OsmNode& node = osmNodes[used[i]];
+        string name = node.name.empty() ? "node " + to_string(used[i]) : node.name;
+        string type = node.name.empty() ? "junction" : (node.type.empty() || node.type == "yes" ? "building" : node.type);
+        g.addNode(i, name, (node.lon - minLon) * metersPerLon, (maxLat - node.lat) * metersPerLat, type);
+    }
+    for (const auto& w : ways) {
+        string pathType = osmPathType(w.highway);
+        for (size_t i = 0; i + 1 < w.refs.size(); i++) {
+            auto a = ids.find(w.refs[i]);
+            auto b = ids.find(w.refs[i + 1]);
+            if (a == ids.end() || b == ids.end() || a->second == b->second) continue;
+            const OsmNode& p = osmNodes[w.refs[i]];
+            const OsmNode& q = osmNodes[w.refs[i + 1]];
+            int weight = max(1, static_cast<int>(lround(haversineMeters(p.lat, p.lon, q.lat, q.lon))));
+            g.addEdge(a->second, b->second, weight, pathType);
+        }
+    }
+    g.buildIndexes();
+    return g;
+}
+
+// ---------- Binary snapshot ----------
+//
+// Native-endian file holding the node and edge records, a deduplicated string
+// table and the prebuilt CSR and name indexes, laid out so every section is
+// 8-byte aligned. Loading maps the file and copies the arrays straight into
+// the Graph, skipping parsing, CSR construction and the name sorts.
+
+const char SNAPSHOT_MAGIC[8] = {'C', 'G', 'R', 'A', 'P', 'H', '\0', '\1'};
+const uint32_t SNAPSHOT_VERSION = 1;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t nodeCount;
+    uint32_t edgeCount;
+    uint32_t adjCount;
+    uint64_t stringBytes;
+    double heuristicScale;
+};
+
+struct SnapshotString {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct SnapshotNode {
+    double x, y;
+    SnapshotString name, type;
+};
+
+struct SnapshotEdge {
+    int32_t from, to, weight;
+    SnapshotString type;
+    uint32_t padding;
+};
+
+// Byte offsets of the sections that follow the header
+struct SnapshotLayout {
+    size_t nodes, edges, adjOffsets, adjList, nameOrder, foldedOrder, strings, total;
+
+    static size_t align(size_t offset) {
+        return (offset + 7) & ~size_t(7);
+    }
+
+    SnapshotLayout(const SnapshotHeader& h) {
+        nodes = align(sizeof(SnapshotHeader));
+        edges = align(nodes + sizeof(SnapshotNode) * h.nodeCount);
+        adjOffsets = align(edges + sizeof(SnapshotEdge) * h.edgeCount);
+        adjList = align(adjOffsets + sizeof(int32_t) * (h.nodeCount + 1));
+        nameOrder = align(adjList + sizeof(Adjacency) * h.adjCount);
+        foldedOrder = align(nameOrder + sizeof(int32_t) * h.nodeCount);
+        strings = align(foldedOrder + sizeof(int32_t) * h.nodeCount);
+        total = strings + h.stringBytes;
+    }
+};
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+private:
+    const char* bytes;
+    size_t length;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+
+public:
+    MappedFile(const string& path) : bytes(nullptr), length(0) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) throw runtime_error("Cannot open " + path);
+        LARGE_INTEGER size;
+        GetFileSizeEx(file, &size);
+        length = static_cast<size_t>(size.QuadPart);
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping) bytes = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (!bytes) {
+            if (mapping) CloseHandle(mapping);
+            CloseHandle(file);
+            throw runtime_error("Cannot map " + path);
+        }
+#else
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw runtime_error("Cannot open " + path);
+        struct stat info;
+        fstat(fd, &info);
+        length = info.st_size;
+        void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED) {
+            close(fd);
+            throw runtime_error("Cannot map " + path);
+        }
+        bytes = static_cast<const char*>(view);
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        UnmapViewOfFile(bytes);
+        CloseHandle(mapping);
+        CloseHandle(file);
+#else
+        munmap(const_cast<char*>(bytes), length);
+        close(fd);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const {
+        return bytes;
+    }
+
+    size_t size() const {
+        return length;
+    }
+};
+
+void saveGraphSnapshot(const Graph& g, const string& path) {
+    // Deduplicated string table; types in particular repeat a lot
+    string strings;
+    unordered_map<string, SnapshotString> interned;
+    auto intern = [&](string_view view) {
+        string s(view);
+        auto it = interned.find(s);
+        if (it != interned.end()) return it->second;
+        SnapshotString ref = {static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(s.size())};
+        strings += s;
+        interned[s] = ref;
+        return ref;
+    };
+
+    vector<SnapshotNode> nodes;
+    nodes.reserve(g.size());
+    for (int v = 0; v < g.size(); v++) {
+        Node node = g.getNode(v);
+        nodes.push_back({node.x, node.y, intern(node.name), intern(node.type)});
+    }
+    vector<SnapshotEdge> edges;
+    edges.reserve(g.getEdges().size());
+    for (const auto& edge : g.getEdges()) {
+        edges.push_back({edge.from, edge.to, edge.weight, intern(g.getPathTypeName(edge.pathType)), 0});
+    }
+    vector<int32_t> foldedOrder;
+    foldedOrder.reserve(g.size());
+    for (const auto& entry : g.getFoldedNames()) foldedOrder.push_back(entry.second);
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.nodeCount = g.size();
+    header.edgeCount = edges.size();
+    header.adjCount = g.getAdjList().size();
+    header.stringBytes = strings.size();
+    header.heuristicScale = g.getHeuristicScale();
+    SnapshotLayout layout(header);
+
+    string out(layout.total, '\0');
+    auto put = [&](size_t offset, const void* data, size_t bytes) {
+        if (bytes) memcpy(&out[offset], data, bytes);
+    };
+    put(0, &header, sizeof(header));
+    put(layout.nodes, nodes.data(), nodes.size() * sizeof(SnapshotNode));
+    put(layout.edges, edges.data(), edges.size() * sizeof(SnapshotEdge));
+    put(layout.adjOffsets, g.getAdjOffsets().data(), (g.size() + 1) * sizeof(int32_t));
+    put(layout.adjList, g.getAdjList().data(), g.getAdjList().size() * sizeof(Adjacency));
+    put(layout.nameOrder, g.getNameOrder().data(), g.size() * sizeof(int32_t));
+    put(layout.foldedOrder, foldedOrder.data(), foldedOrder.size() * sizeof(int32_t));
+    put(layout.strings, strings.data(), strings.size());
+
+    ofstream file(path, ios::binary | ios::trunc);
+    if (!file.write(out.data(), out.size())) throw runtime_error("Cannot write " + path);
+}
+
+Graph loadGraphSnapshot(const string& path) {
+    MappedFile file(path);
+    const char* base = file.data();
+
+    SnapshotHeader header;
+    if (file.size() < sizeof(header)) throw runtime_error(path + ": not a graph snapshot");
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+        throw runtime_error(path + ": not a graph snapshot");
+    }
+    if (header.version != SNAPSHOT_VERSION) {
+        throw runtime_error(path + ": unsupported snapshot version " + to_string(header.version));
+    }
+    SnapshotLayout layout(header);
+    if (file.size() < layout.total) throw runtime_error(path + ": truncated snapshot");
+
+    int n = header.nodeCount;
+    const char* strings = base + layout.strings;
+    auto text = [&](const SnapshotString& s) {
+        if ((uint64_t)s.offset + s.length > header.stringBytes) throw runtime_error(path + ": corrupt string table");
+        return string(strings + s.offset, s.length);
+    };
+    auto ints = [&](size_t offset, size_t count) {
+        const int32_t* first = reinterpret_cast<const int32_t*>(base + offset);
+        return vector<int>(first, first + count);
+    };
+
+    Graph g(n);
+    const SnapshotNode* nodes = reinterpret_cast<const SnapshotNode*>(base + layout.nodes);
+    for (int i = 0; i < n; i++) {
+        g.addNode(i, text(nodes[i].name), nodes[i].x, nodes[i].y, text(nodes[i].type));
+    }
+    const SnapshotEdge* edges = reinterpret_cast<const SnapshotEdge*>(base + layout.edges);
+    for (uint32_t i = 0; i < header.edgeCount; i++) {
+        const SnapshotEdge& edge = edges[i];
+        // addEdge drops edges to unknown nodes; here that means a damaged
+        // file, and a negative weight would break the shortest-path searches
+        if (edge.from < 0 || edge.from >= n || edge.to < 0 || edge.to >= n || edge.weight < 0) {
+            throw runtime_error(path + ": corrupt edge " + to_string(i));
+        }
+        g.addEdge(edge.from, edge.to, edge.weight, text(edge.type));
+    }
+
+    // Validate the indexes so a damaged file cannot cause out-of-range reads
+    vector<int> offsets = ints(layout.adjOffsets, n + 1);
+    const Adjacency* adjFirst = reinterpret_cast<const Adjacency*>(base + layout.adjList);
+    vector<Adjacency> adjList(adjFirst, adjFirst + header.adjCount);
+    vector<int> nameOrder = ints(layout.nameOrder, n);
+    vector<int> foldedOrder = ints(layout.foldedOrder, n);
+
+    bool valid = offsets[0] == 0 && offsets[n] == (int)header.adjCount;
+    for (int u = 0; valid && u < n; u++) valid = offsets[u] <= offsets[u + 1];
+    for (size_t i = 0; valid && i < adjList.size(); i++) {
+        valid = adjList[i].to >= 0 && adjList[i].to < n && adjList[i].weight >= 0;
+    }
+    for (int i = 0; valid && i < n; i++) {
+        valid = nameOrder[i] >= 0 && nameOrder[i] < n && foldedOrder[i] >= 0 && foldedOrder[i] < n;
+    }
+    if (!valid) throw runtime_error(path + ": corrupt snapshot indexes");
+
+    g.restoreIndexes(move(offsets), move(adjList), header.heuristicScale, move(nameOrder), foldedOrder);
+    return g;
+}
+
+// ---------- Dispatch ----------
+
+Graph loadGraph(const string& path) {
+    if (hasExtension(path, ".cgs")) return loadGraphSnapshot(path);
+    if (hasExtension(path, ".json")) return loadGraphJSON(path);
+    if (hasExtension(path, ".csv")) return loadGraphCSV(path);
+    if (hasExtension(path, ".osm")) return loadGraphOSM(path);
+    throw runtime_error("Unknown graph format: " + path + " (expected .json, .csv, .osm or .cgs)");
+}
+
+// Write a graph as JSON or as a binary snapshot, by extension
+void saveGraph(const Graph& g, const string& path) {
+    if (hasExtension(path, ".cgs")) {
+        saveGraphSnapshot(g, path);
+        return;
+    }
+    if (!hasExtension(path, ".json")) throw runtime_error("Can only write .json or .cgs: " + path);
+
+    json data;
+    data["nodes"] = json::array();
+    data["edges"] = json::array();
+    for (int v = 0; v < g.size(); v++) {
+        Node node = g.getNode(v);
+        data["nodes"].push_back({{"id", node.id}, {"name", node.name}, {"x", node.x}, {"y", node.y}, {"type", node.type}});
+    }
+    for (const auto& edge : g.getEdges()) {
+        data["edges"].push_back({{"from", edge.from}, {"to", edge.to}, {"weight", edge.weight},
+                                 {"type", g.getPathTypeName(edge.pathType)}});
+    }
+    ofstream file(path, ios::trunc);
+    if (!(file << data.dump(2) << "\n")) throw runtime_error("Cannot write " + path);
+}
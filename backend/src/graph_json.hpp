@@ -0,0 +1,75 @@
+#pragma once
+#include "graph.hpp"
+#include "json_stream.hpp"
+#include "../lib/json.hpp"
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+using namespace std;
+
+// Nodes and edges of a graph for /api/graph, as a DOM for the binary formats
+json graphJSON(const Graph& graph) {
+    json graphData;
+    graphData["nodes"] = json::array();
+    graphData["edges"] = json::array();
+    
+    for (int v = 0; v < graph.size(); v++) {
+        Node node = graph.getNode(v);
+        graphData["nodes"].push_back({
+            {"id", node.id},
+            {"name", node.name},
+            {"x", node.x},
+            {"y", node.y},
+            {"type", node.type}
+        });
+    }
+    
+    for (const auto& edge : graph.getEdges()) {
+        graphData["edges"].push_back({
+            {"from", edge.from},
+            {"to", edge.to},
+            {"weight", edge.weight},
+            {"type", graph.getPathTypeName(edge.pathType)}
+        });
+    }
+    return graphData;
+}
+
+// graphJSON(graph).dump() written straight from the graph arrays, keys in
+// the same sorted order, without building the DOM. The bytes match the dump
+// exactly, so both give the same ETag.
+string graphBody(const Graph& graph) {
+    string body;
+    StringSink sink(body);
+    JsonWriter out(sink);
+    const vector<double>& xs = graph.getXs();
+    const vector<double>& ys = graph.getYs();
+    
+    out.beginObject();
+    out.key("edges");
+    out.beginArray();
+    for (const auto& edge : graph.getEdges()) {
+        out.beginObject();
+        out.field("from", edge.from);
+        out.field("to", edge.to);
+        out.field("type", graph.getPathTypeName(edge.pathType));
+        out.field("weight", edge.weight);
+        out.endObject();
+    }
+    out.endArray();
+    out.key("nodes");
+    out.beginArray();
+    for (int v = 0; v < graph.size(); v++) {
+        out.beginObject();
+        out.field("id", v);
+        out.field("name", graph.getName(v));
+        out.field("type", graph.getNode(v).type);
+        out.field("x", xs[v]);
+        out.field("y", ys[v]);
+        out.endObject();
+    }
+    out.endArray();
+    out.endObject();
+    return body;
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <charconv>
+
+using namespace std;
+
+// Case-insensitive ASCII comparison, for header names and tokens
+bool equalsIgnoreCase(string_view a, string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        char x = a[i], y = b[i];
+        if (x >= 'A' && x <= 'Z') x += 'a' - 'A';
+        if (y >= 'A' && y <= 'Z') y += 'a' - 'A';
+        if (x != y) return false;
+    }
+    return true;
+}
+
+// Strip spaces and tabs from both ends
+string_view trimView(string_view s) {
+    size_t first = s.find_first_not_of(" \t");
+    if (first == string_view::npos) return string_view();
+    size_t last = s.find_last_not_of(" \t");
+    return s.substr(first, last - first + 1);
+}
+
+// One parsed HTTP request. Every view points into the connection buffer
+// and is only valid until that buffer is modified.
+struct HttpRequest {
+    string_view method;
+    string_view target;   // path plus "?query"
+    string_view path;
+    string_view query;    // without the '?'
+    string_view version;
+    vector<pair<string_view, string_view>> headers;
+    string_view body;
+    size_t length;        // bytes consumed from the buffer, headers + body
+
+    HttpRequest() : length(0) {}
+
+    // Value of a header, empty if absent
+    string_view header(string_view name) const {
+        for (const auto& h : headers) {
+            if (equalsIgnoreCase(h.first, name)) return h.second;
+        }
+        return string_view();
+    }
+
+    // HTTP/1.1 keeps the connection open unless asked not to, HTTP/1.0 only on request
+    bool keepAlive() const {
+        string_view connection = header("Connection");
+        if (equalsIgnoreCase(connection, "close")) return false;
+        if (equalsIgnoreCase(connection, "keep-alive")) return true;
+        return version == "HTTP/1.1";
+    }
+};
+
+enum ParseStatus {
+    PARSE_INCOMPLETE,   // need more bytes
+    PARSE_OK,
+    PARSE_ERROR         // malformed or unsupported, answer 400 and close
+};
+
+// Incremental request parser. Feed it the growing buffer after every recv:
+// it only scans the new bytes for the end of the headers, then parses the
+// request line and headers in a single pass without copying.
+class HttpRequestParser {
+private:
+    size_t scanned;   // bytes already searched for the header terminator
+
+public:
+    HttpRequestParser() : scanned(0) {}
+
+    // Call after a request has been consumed from the buffer
+    void reset() {
+        scanned = 0;
+    }
+
+    ParseStatus parse(string_view buffer, HttpRequest& request) {
+        // Ignore blank lines between pipelined requests
+        size_t begin = 0;
+        while (buffer.substr(begin, 2) == "\r\n") begin += 2;
+
+        size_t from = (scanned > begin + 3) ? scanned - 3 : begin;
+        size_t headerEnd = buffer.find("\r\n\r\n", from);
+        if (headerEnd == string_view::npos) {
+            scanned = buffer.size();
+            return PARSE_INCOMPLETE;
+        }
+
+        request = HttpRequest();
+        string_view head = buffer.substr(begin, headerEnd + 2 - begin);
+
+        // Request line: METHOD SP target SP version CRLF
+        size_t lineEnd = head.find("\r\n");
+        string_view line = head.substr(0, lineEnd);
+        size_t sp1 = line.find(' ');
+        size_t sp2 = (sp1 == string_view::npos) ? string_view::npos : line.find(' ', sp1 + 1);
+        if (sp2 == string_view::npos) return PARSE_ERROR;
+
+        request.method = line.substr(0, sp1);
+        request.target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+        request.version = line.substr(sp2 + 1);
+        if (request.method.empty() || request.target.empty() ||
+            request.version.substr(0, 5) != "HTTP/") {
+            return PARSE_ERROR;
+        }
+
+        size_t question = request.target.find('?');
+        request.path = request.target.substr(0, question);
+        if (question != string_view::npos) {
+            request.query = request.target.substr(question + 1);
+        }
+
+        // Header lines: name ":" OWS value OWS CRLF
+        size_t lineStart = lineEnd + 2;
+        while (lineStart < head.size()) {
+            lineEnd = head.find("\r\n", lineStart);
+            string_view headerLine = head.substr(lineStart, lineEnd - lineStart);
+            size_t colon = headerLine.find(':');
+            if (colon == string_view::npos || colon == 0) return PARSE_ERROR;
+            request.headers.push_back({headerLine.substr(0, colon), trimView(headerLine.substr(colon + 1))});
+            lineStart = lineEnd + 2;
+        }
+
+        if (!request.header("Transfer-Encoding").empty()) return PARSE_ERROR;
+
+        size_t contentLength = 0;
+        string_view contentLengthValue = request.header("Content-Length");
+        if (!contentLengthValue.empty()) {
+            const char* first = contentLengthValue.data();
+            const char* last = first + contentLengthValue.size();
+            auto converted = from_chars(first, last, contentLength);
+            if (converted.ec != errc() || converted.ptr != last) return PARSE_ERROR;
+        }
+
+        size_t bodyStart = headerEnd + 4;
+        if (buffer.size() - bodyStart < contentLength) {
+            scanned = headerEnd;   // headers are re-read once the body is in
+            return PARSE_INCOMPLETE;
+        }
+
+        request.body = buffer.substr(bodyStart, contentLength);
+        request.length = bodyStart + contentLength;
+        return PARSE_OK;
+    }
+};
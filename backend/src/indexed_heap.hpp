@@ -0,0 +1,142 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+using namespace std;
+
+// Indexed 4-ary min-heap of (key, node) pairs for Dijkstra-style searches.
+// A node is queued at most once: pushing a queued node lowers its key in
+// place (decrease-key), so there are no stale entries to skip on pop.
+// Entries compare as pairs, so equal keys come out in node id order, the
+// same order as a priority_queue<pair<int, int>> with greater<>.
+class IndexedHeap {
+private:
+    static const size_t ARITY = 4;
+
+    vector<pair<int, int>> entries;   // (key, node) in heap order
+    vector<int> position;             // node -> index in entries, -1 if not queued
+    mutable vector<size_t> frontier;  // scratch for forEachOrdered
+    size_t pushed;                    // pushes that changed the heap since the last clear()
+
+    void place(size_t i, const pair<int, int>& entry) {
+        entries[i] = entry;
+        position[entry.second] = static_cast<int>(i);
+    }
+
+    void siftUp(size_t i) {
+        pair<int, int> entry = entries[i];
+        while (i > 0) {
+            size_t parent = (i - 1) / ARITY;
+            if (!(entry < entries[parent])) break;
+            place(i, entries[parent]);
+            i = parent;
+        }
+        place(i, entry);
+    }
+
+    void siftDown(size_t i) {
+        pair<int, int> entry = entries[i];
+        size_t count = entries.size();
+        while (true) {
+            size_t first = i * ARITY + 1;
+            if (first >= count) break;
+            size_t last = min(first + ARITY, count);
+            size_t best = first;
+            for (size_t c = first + 1; c < last; c++) {
+                if (entries[c] < entries[best]) best = c;
+            }
+            if (!(entries[best] < entry)) break;
+            place(i, entries[best]);
+            i = best;
+        }
+        place(i, entry);
+    }
+
+public:
+    // Heap for node ids 0..nodes-1
+    explicit IndexedHeap(int nodes = 0) : position(nodes, -1), pushed(0) {}
+
+    bool empty() const {
+        return entries.empty();
+    }
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    // Insertions and decrease-keys since construction or the last clear()
+    size_t pushCount() const {
+        return pushed;
+    }
+
+    bool contains(int node) const {
+        return position[node] != -1;
+    }
+
+    // Smallest (key, node); the heap must not be empty
+    const pair<int, int>& top() const {
+        return entries[0];
+    }
+
+    // Queue node with key, or lower its key if it is already queued with a
+    // larger one. Returns false if the heap did not change.
+    bool push(int node, int key) {
+        int i = position[node];
+        if (i == -1) {
+            entries.push_back({key, node});
+            siftUp(entries.size() - 1);
+            pushed++;
+            return true;
+        }
+        if (key >= entries[i].first) return false;
+        entries[i].first = key;
+        siftUp(i);
+        pushed++;
+        return true;
+    }
+
+    // Remove and return the smallest (key, node)
+    pair<int, int> pop() {
+        pair<int, int> smallest = entries[0];
+        position[smallest.second] = -1;
+        pair<int, int> last = entries.back();
+        entries.pop_back();
+        if (!entries.empty()) {
+            entries[0] = last;
+            siftDown(0);
+        }
+        return smallest;
+    }
+
+    void clear() {
+        for (const auto& entry : entries) position[entry.second] = -1;
+        entries.clear();
+        pushed = 0;
+    }
+
+    // Call visit(entry) for every queued (key, node) in pop order, without
+    // copying or draining the heap. A node is only reached after its heap
+    // parent, so a small frontier of candidate indexes is enough.
+    template <typename Visit>
+    void forEachOrdered(Visit visit) const {
+        if (entries.empty()) return;
+        auto later = [this](size_t a, size_t b) { return entries[b] < entries[a]; };
+
+        frontier.clear();
+        frontier.push_back(0);
+        while (!frontier.empty()) {
+            pop_heap(frontier.begin(), frontier.end(), later);
+            size_t i = frontier.back();
+            frontier.pop_back();
+            visit(entries[i]);
+
+            size_t first = i * ARITY + 1;
+            size_t last = min(first + ARITY, entries.size());
+            for (size_t c = first; c < last; c++) {
+                frontier.push_back(c);
+                push_heap(frontier.begin(), frontier.end(), later);
+            }
+        }
+    }
+};
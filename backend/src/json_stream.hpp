@@ -0,0 +1,239 @@
+#pragma once
+#include "../lib/json.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <charconv>
+#include <stdexcept>
+
+using json = nlohmann::json;
+using namespace std;
+
+// Destination for streamed JSON text
+class JsonSink {
+public:
+    virtual ~JsonSink() {}
+    virtual void write(string_view data) = 0;
+};
+
+// Collects the output in a string
+class StringSink : public JsonSink {
+private:
+    string& out;
+
+public:
+    StringSink(string& out) : out(out) {}
+
+    void write(string_view data) override {
+        out.append(data.data(), data.size());
+    }
+};
+
+// Minimal JSON writer that emits text as values are added, so large
+// responses can be serialized straight from the C++ structs into a sink
+// without building a json DOM first. Commas are inserted automatically.
+class JsonWriter {
+private:
+    JsonSink& sink;
+    vector<bool> needComma;   // one entry per open object/array
+    bool afterKey;
+
+    void separate() {
+        if (afterKey) {
+            afterKey = false;
+            return;
+        }
+        if (!needComma.empty()) {
+            if (needComma.back()) sink.write(",");
+            needComma.back() = true;
+        }
+    }
+
+    // Length of the well-formed UTF-8 sequence starting at s[i], 0 if the
+    // bytes there are not one (overlong forms and surrogates included)
+    static size_t utf8Length(string_view s, size_t i) {
+        unsigned char c = s[i];
+        size_t length;
+        unsigned char low = 0x80, high = 0xBF;   // bounds of the second byte
+        if (c >= 0xC2 && c <= 0xDF) length = 2;
+        else if (c >= 0xE0 && c <= 0xEF) {
+            length = 3;
+            if (c == 0xE0) low = 0xA0;
+            if (c == 0xED) high = 0x9F;
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            length = 4;
+            if (c == 0xF0) low = 0x90;
+            if (c == 0xF4) high = 0x8F;
+        } else {
+            return 0;
+        }
+        if (i + length > s.size()) return 0;
+        unsigned char second = s[i + 1];
+        if (second < low || second > high) return 0;
+        for (size_t k = 2; k < length; k++) {
+            unsigned char next = s[i + k];
+            if (next < 0x80 || next > 0xBF) return 0;
+        }
+        return length;
+    }
+
+    // Escaped like json::dump: the short escapes it uses, \u00xx for the
+    // other control characters, UTF-8 passed through and rejected if invalid
+    void writeString(string_view s) {
+        static const char* hexDigits = "0123456789abcdef";
+        sink.write("\"");
+        size_t runStart = 0;
+        for (size_t i = 0; i < s.size(); i++) {
+            unsigned char c = s[i];
+            if (c >= 0x80) {
+                size_t length = utf8Length(s, i);
+                if (length == 0) {
+                    throw invalid_argument("invalid UTF-8 byte at index " + to_string(i) + ": 0x" +
+                                           hexDigits[c >> 4] + hexDigits[c & 15]);
+                }
+                i += length - 1;
+                continue;
+            }
+            if (c != '"' && c != '\\' && c >= 0x20) continue;
+
+            sink.write(s.substr(runStart, i - runStart));
+            switch (c) {
+                case '"': sink.write("\\\""); break;
+                case '\\': sink.write("\\\\"); break;
+                case '\b': sink.write("\\b"); break;
+                case '\f': sink.write("\\f"); break;
+                case '\n': sink.write("\\n"); break;
+                case '\r': sink.write("\\r"); break;
+                case '\t': sink.write("\\t"); break;
+                default: {
+                    char escaped[] = {'\\', 'u', '0', '0', hexDigits[c >> 4], hexDigits[c & 15]};
+                    sink.write(string_view(escaped, sizeof(escaped)));
+                }
+            }
+            runStart = i + 1;
+        }
+        sink.write(s.substr(runStart));
+        sink.write("\"");
+    }
+
+public:
+    JsonWriter(JsonSink& sink) : sink(sink), afterKey(false) {}
+
+    void beginObject() {
+        separate();
+        sink.write("{");
+        needComma.push_back(false);
+    }
+
+    void endObject() {
+        needComma.pop_back();
+        sink.write("}");
+    }
+
+    void beginArray() {
+        separate();
+        sink.write("[");
+        needComma.push_back(false);
+    }
+
+    void endArray() {
+        needComma.pop_back();
+        sink.write("]");
+    }
+
+    void key(string_view name) {
+        separate();
+        writeString(name);
+        sink.write(":");
+        afterKey = true;
+    }
+
+    void value(int v) {
+        separate();
+        char digits[16];
+        auto converted = to_chars(digits, digits + sizeof(digits), v);
+        sink.write(string_view(digits, converted.ptr - digits));
+    }
+
+    // Formatted by json::dump itself, so the text matches a DOM dump
+    // exactly (150.0, 1e+20, null for non-finite values)
+    void value(double v) {
+        separate();
+        sink.write(json(v).dump());
+    }
+
+    void value(bool v) {
+        separate();
+        sink.write(v ? "true" : "false");
+    }
+
+    void value(string_view s) {
+        separate();
+        writeString(s);
+    }
+
+    void value(const char* s) {
+        value(string_view(s));
+    }
+
+    // std::string and arena strings alike
+    template <typename Alloc>
+    void value(const basic_string<char, char_traits<char>, Alloc>& s) {
+        value(string_view(s));
+    }
+
+    // Any json DOM value, for small or irregular parts of a response
+    void value(const json& j) {
+        separate();
+        sink.write(j.dump());
+    }
+
+    // Arrays, from std::vector or arena vectors
+
+    template <typename Alloc>
+    void value(const vector<int, Alloc>& values) {
+        beginArray();
+        for (int v : values) value(v);
+        endArray();
+    }
+
+    template <typename Alloc>
+    void value(const vector<bool, Alloc>& values) {
+        beginArray();
+        for (bool v : values) value(v);
+        endArray();
+    }
+
+    template <typename Alloc>
+    void value(const vector<string_view, Alloc>& values) {
+        beginArray();
+        for (string_view v : values) value(v);
+        endArray();
+    }
+
+    template <typename Alloc>
+    void value(const vector<pair<int, int>, Alloc>& values) {
+        beginArray();
+        for (const auto& v : values) {
+            beginArray();
+            value(v.first);
+            value(v.second);
+            endArray();
+        }
+        endArray();
+    }
+
+    template <typename T>
+    void field(string_view name, const T& v) {
+        key(name);
+        value(v);
+    }
+
+    // Every member of a json object, into the object currently open
+    void fields(const json& object) {
+        for (auto it = object.begin(); it != object.end(); ++it) {
+            key(it.key());
+            value(it.value());
+        }
+    }
+};
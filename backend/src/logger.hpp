@@ -0,0 +1,147 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <stdexcept>
+
+using namespace std;
+
+enum LogLevel {
+    LOG_DEBUG,
+    LOG_INFO,
+    LOG_WARN,
+    LOG_ERROR
+};
+
+// Parse --log-level
+LogLevel parseLogLevel(const string& value) {
+    if (value == "debug") return LOG_DEBUG;
+    if (value == "info") return LOG_INFO;
+    if (value == "warn") return LOG_WARN;
+    if (value == "error") return LOG_ERROR;
+    throw invalid_argument("Unknown log level: " + value);
+}
+
+const char* logLevelName(LogLevel level) {
+    switch (level) {
+        case LOG_DEBUG: return "DEBUG";
+        case LOG_WARN: return "WARN";
+        case LOG_ERROR: return "ERROR";
+        default: return "INFO";
+    }
+}
+
+// Lines waiting beyond this are dropped rather than blocking request threads
+const size_t LOG_QUEUE_LIMIT = 10000;
+
+// Levelled logger that never writes on the caller's thread. Lines are queued
+// and a background thread writes them in batches, one flush per batch:
+// warnings and errors to stderr, the rest to stdout. Whatever is still
+// queued is written when the logger is destroyed.
+class Logger {
+private:
+    struct Line {
+        LogLevel level;
+        string text;
+    };
+
+    vector<Line> queue;
+    mutex lock;
+    condition_variable ready;
+    bool stopping;
+    size_t dropped;
+    atomic<int> minLevel;
+    thread writer;
+
+    void writerLoop() {
+        vector<Line> batch;
+        while (true) {
+            size_t lost;
+            {
+                unique_lock<mutex> guard(lock);
+                ready.wait(guard, [this] { return stopping || !queue.empty(); });
+                if (queue.empty()) return;   // stopping with nothing left
+                batch.swap(queue);
+                lost = dropped;
+                dropped = 0;
+            }
+
+            string out, errors;
+            for (const Line& line : batch) (line.level >= LOG_WARN ? errors : out) += line.text;
+            if (lost > 0) errors += "[WARN] " + to_string(lost) + " log lines dropped\n";
+            if (!out.empty()) cout << out << flush;
+            if (!errors.empty()) cerr << errors << flush;
+            batch.clear();
+        }
+    }
+
+public:
+    Logger(LogLevel level = LOG_INFO) : stopping(false), dropped(0), minLevel(level) {
+        writer = thread([this] { writerLoop(); });
+    }
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    ~Logger() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        ready.notify_one();
+        writer.join();
+    }
+
+    void setLevel(LogLevel level) {
+        minLevel = level;
+    }
+
+    // Cheap check for callers that build expensive messages
+    bool enabled(LogLevel level) const {
+        return level >= minLevel.load(memory_order_relaxed);
+    }
+
+    void log(LogLevel level, const string& message) {
+        if (!enabled(level)) return;
+
+        char stamp[32];
+        time_t now = chrono::system_clock::to_time_t(chrono::system_clock::now());
+        tm local;
+#ifdef _WIN32
+        localtime_s(&local, &now);
+#else
+        localtime_r(&now, &local);
+#endif
+        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+
+        string text;
+        text.reserve(message.length() + 40);
+        text += stamp;
+        text += " [";
+        text += logLevelName(level);
+        text += "] ";
+        text += message;
+        text += '\n';
+
+        {
+            lock_guard<mutex> guard(lock);
+            if (queue.size() >= LOG_QUEUE_LIMIT) {
+                dropped++;
+                return;
+            }
+            queue.push_back({level, move(text)});
+        }
+        ready.notify_one();
+    }
+
+    void debug(const string& message) { log(LOG_DEBUG, message); }
+    void info(const string& message) { log(LOG_INFO, message); }
+    void warn(const string& message) { log(LOG_WARN, message); }
+    void error(const string& message) { log(LOG_ERROR, message); }
+};
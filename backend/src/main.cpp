@@ -1,163 +1,1117 @@
 #include <iostream>
 #include <string>
 #include <cstring>
-#include <winsock2.h>
-#include <ws2tcpip.h>
 #include <sstream>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #include "graph.hpp"
+#include "graph_io.hpp"
 #include "dijkstra.hpp"
+#include "route.hpp"
+#include "distance_table.hpp"
+#include "matrix.hpp"
+#include "batch_route.hpp"
+#include "spatial_index.hpp"
+#include "facility.hpp"
+#include "arena.hpp"
+#include "cache.hpp"
+#include "thread_pool.hpp"
 #include "search.hpp"
 #include "sort.hpp"
 #include "utils.hpp"
+#include "http.hpp"
+#include "net.hpp"
+#include "connection_loop.hpp"
+#include "json_stream.hpp"
+#include "graph_json.hpp"
+#include "wire_format.hpp"
+#include "compress.hpp"
+#include "metrics.hpp"
+#include "logger.hpp"
 #include "../lib/json.hpp"
 
 using namespace std;
 using json = nlohmann::json;
 
-// Global campus graph
-Graph campusGraph = createCampusGraph();
+// Serialized bodies of recent responses, keyed by graph version + endpoint + parameters
+ResponseCache responseCache;
 
-// Send HTTP response
-void sendResponse(int clientSocket, const string& content, const string& contentType = "application/json") {
+// Request counters and latency histograms for /api/metrics
+Metrics serverMetrics;
+
+// Request and error log, written from a background thread
+Logger serverLog;
+
+// Build the distance table for each graph version, unless --no-precompute
+bool precomputeEnabled = true;
+
+// A response body serialized ahead of time, with precompressed copies
+struct StaticResponse {
+    string body;
+    string gzipBody;
+    string deflateBody;
+    string etag;
+};
+
+// One version of the campus graph with everything derived from it.
+// Published versions are never modified, so requests read them without
+// locking and in-flight queries finish on the version they started with.
+struct GraphState {
+    Graph graph;
+    DistanceTable distanceTable;    // empty if precomputation is off or the graph is too large
+    SpatialIndex spatialIndex;      // node coordinates, for /api/nearest and coordinate snapping
+    FacilityTable facilityTable;    // empty if precomputation is off or the graph has too many types
+    StaticResponse graphResponse;   // JSON /api/graph
+    unsigned long long version;
+
+    GraphState(Graph g, unsigned long long version) : graph(move(g)), version(version) {}
+};
+
+// Current graph version, read and replaced with atomic shared_ptr operations
+shared_ptr<const GraphState> graphState;
+
+// Serializes graph updates; readers never take it
+mutex graphUpdateLock;
+
+shared_ptr<const GraphState> currentGraph() {
+    return atomic_load(&graphState);
+}
+
+// Hub labels take seconds to build, far too long for the request that
+// changed an edge. A version that needs them is published without a table,
+// so routes fall back to search meanwhile, and one builder thread makes
+// the labels and republishes it with them. While it works, later versions
+// replace the one it waits for, so updates in a burst cost a single build.
+mutex tableBuildLock;
+shared_ptr<const GraphState> tableBuildWanted;   // next version to build for, guarded by tableBuildLock
+bool tableBuilderRunning = false;                // guarded by tableBuildLock
+
+void publishBuiltTable(const shared_ptr<const GraphState>& built, DistanceTable table) {
+    lock_guard<mutex> guard(graphUpdateLock);
+    if (currentGraph() != built) return;   // the graph changed since; that version is queued
+    // Same graph, same version: cache keys already say whether the table answered
+    long long millis = lround(table.buildTimeMillis());
+    auto next = make_shared<GraphState>(*built);
+    next->distanceTable = move(table);
+    atomic_store(&graphState, shared_ptr<const GraphState>(move(next)));
+    serverLog.info("Hub labels for graph version " + to_string(built->version) + " built in " +
+                   to_string(millis) + " ms");
+}
+
+void buildTablesInBackground() {
+    while (true) {
+        shared_ptr<const GraphState> state;
+        {
+            lock_guard<mutex> guard(tableBuildLock);
+            state = move(tableBuildWanted);
+            tableBuildWanted.reset();
+            if (!state) {
+                tableBuilderRunning = false;
+                return;
+            }
+        }
+        DistanceTable table;
+        table.build(state->graph);
+        publishBuiltTable(state, move(table));
+    }
+}
+
+void scheduleTableBuild(shared_ptr<const GraphState> state) {
+    lock_guard<mutex> guard(tableBuildLock);
+    tableBuildWanted = move(state);
+    if (!tableBuilderRunning) {
+        tableBuilderRunning = true;
+        thread(buildTablesInBackground).detach();
+    }
+}
+
+// True while a version waits for its hub labels
+bool tableBuildPending() {
+    lock_guard<mutex> guard(tableBuildLock);
+    return tableBuilderRunning;
+}
+
+// Build everything derived from a graph and make it the current version.
+// If the graph differs from the current one by a single edge change, the
+// distance and facility tables are repaired incrementally, sharing every
+// tree the change leaves alone; hub labels are rebuilt in the background.
+// Writers must hold graphUpdateLock once the server is running.
+void publishGraph(Graph graph, const EdgeChange* change = nullptr) {
+    shared_ptr<const GraphState> previous = currentGraph();
+    auto next = make_shared<GraphState>(move(graph), previous ? previous->version + 1 : 1);
+    bool edgeChange = change && previous;
+    bool buildLater = false;
+    
+    if (precomputeEnabled) {
+        if (edgeChange && previous->distanceTable.repairable(next->graph)) {
+            next->distanceTable = previous->distanceTable;
+            next->distanceTable.update(next->graph, *change);
+        } else if (edgeChange && DistanceTable::usesHubLabels(next->graph.size())) {
+            buildLater = true;
+        } else {
+            next->distanceTable.build(next->graph);
+        }
+        
+        bool repaired = false;
+        if (edgeChange) {
+            next->facilityTable = previous->facilityTable;
+            repaired = next->facilityTable.update(next->graph, *change);
+        }
+        if (!repaired) {
+            next->facilityTable.build(next->graph);
+        }
+    }
+    // Edge changes leave the nodes where they were
+    if (edgeChange) {
+        next->spatialIndex = previous->spatialIndex;
+    } else {
+        next->spatialIndex.build(next->graph);
+    }
+    // The best level takes about 270 ms per copy at 10k nodes, too slow to
+    // repeat on every edge change; later versions use the per-request level
+    int level = edgeChange ? DYNAMIC_COMPRESSION_LEVEL : Z_BEST_COMPRESSION;
+    next->graphResponse.body = graphBody(next->graph);
+    next->graphResponse.gzipBody = compressBody(next->graphResponse.body, ENCODING_GZIP, level);
+    next->graphResponse.deflateBody = compressBody(next->graphResponse.body, ENCODING_DEFLATE, level);
+    next->graphResponse.etag = makeETag(next->graphResponse.body);
+    
+    shared_ptr<const GraphState> published(move(next));
+    atomic_store(&graphState, published);
+    if (buildLater) scheduleTableBuild(published);
+    
+    // Keys carry the version, so old entries can no longer hit; free them now
+    responseCache.clear();
+}
+
+bool isGraphUpdate(const string& path) {
+    return path == "/api/edges/add" || path == "/api/edges/remove" || path == "/api/edges/weight";
+}
+
+// Request parameter, empty if absent
+string paramValue(const map<string, string>& params, const string& key) {
+    auto it = params.find(key);
+    return it != params.end() ? it->second : string();
+}
+
+// A numeric parameter; throws naming it unless it is a finite number
+double numberParam(const map<string, string>& params, const string& key) {
+    double number;
+    if (!parseNumber(paramValue(params, key), number)) throw invalid_argument(key + " must be a number");
+    return number;
+}
+
+// An integer parameter such as a node id; throws naming it unless it is one
+int intParam(const map<string, string>& params, const string& key) {
+    int integer;
+    if (!parseInteger(paramValue(params, key), integer)) throw invalid_argument(key + " must be an integer");
+    return integer;
+}
+
+// Apply an edge update to a copy of the current graph and publish it
+json updateGraph(const string& path, map<string, string>& params) {
+    lock_guard<mutex> guard(graphUpdateLock);
+    auto begin = chrono::steady_clock::now();
+    shared_ptr<const GraphState> current = currentGraph();
+    Graph graph = current->graph;
+    
+    int from = intParam(params, "from");
+    int to = intParam(params, "to");
+    checkNodeId(graph, from);
+    checkNodeId(graph, to);
+    int weight = params["weight"].empty() ? 0 : intParam(params, "weight");
+    
+    if (path == "/api/edges/add") {
+        if (weight <= 0) throw invalid_argument("weight must be positive");
+        if (from == to) throw invalid_argument("Edge must join two different nodes");
+        graph.addEdge(from, to, weight, params["type"].empty() ? "walkway" : params["type"]);
+    } else if (path == "/api/edges/remove") {
+        if (!graph.removeEdge(from, to)) {
+            throw invalid_argument("No edge between " + to_string(from) + " and " + to_string(to));
+        }
+    } else {
+        if (weight <= 0) throw invalid_argument("weight must be positive");
+        if (!graph.setEdgeWeight(from, to, weight)) {
+            throw invalid_argument("No edge between " + to_string(from) + " and " + to_string(to));
+        }
+    }
+    graph.buildAdjacency();
+    
+    EdgeChange change = {from, to, current->graph.getWeight(from, to), graph.getWeight(from, to)};
+    publishGraph(move(graph), &change);
+    
+    shared_ptr<const GraphState> updated = currentGraph();
+    json result;
+    result["version"] = updated->version;
+    result["nodes"] = updated->graph.size();
+    result["edges"] = updated->graph.getEdges().size();
+    // The whole update: graph copy, tables, /api/graph body and its compressed copies
+    result["millis"] = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+    const DistanceTable& table = updated->distanceTable;
+    if (table.ready()) {
+        result["distanceTable"] = {
+            {"strategy", table.strategyName()},
+            {"millis", table.buildTimeMillis()},
+            {"repairedTrees", table.lastRepairedRows()}
+        };
+    } else if (tableBuildPending()) {
+        result["distanceTable"] = {{"strategy", "hub labels"}, {"building", true}};
+    }
+    if (updated->facilityTable.ready()) {
+        result["facilityTable"] = {
+            {"millis", updated->facilityTable.buildTimeMillis()},
+            {"repairedForests", updated->facilityTable.lastRepairedForests()}
+        };
+    }
+    return result;
+}
+
+// Routing endpoints take their start and end nodes (the source for
+// /api/nearest/facility) as a node id or as "x,y" coordinates. Coordinates
+// are replaced by the nearest node before the request is handled, so the
+// cache sees node ids and the response names the snapped nodes.
+void snapRouteParams(const GraphState& state, const string& path, map<string, string>& params) {
+    vector<const char*> keys;
+    if (path == "/api/dijkstra" || path == "/api/route") keys = {"start", "end"};
+    else if (path == "/api/nearest/facility") keys = {"source"};
+    
+    for (const char* key : keys) {
+        auto it = params.find(key);
+        if (it == params.end() || it->second.find(',') == string::npos) continue;
+        const string& value = it->second;
+        
+        double x, y;
+        if (!parsePoint(value, x, y)) {
+            throw invalid_argument(string(key) + " must be a node id or x,y coordinates");
+        }
+        int node = state.spatialIndex.snap(x, y);
+        if (node == -1) throw invalid_argument("Graph has no nodes");
+        params[key] = to_string(node);
+    }
+}
+
+// Untraced route search, recorded in the search metrics
+json searchRoute(const Graph& graph, int start, int end, RouteEngine engine) {
+    RouteResult route = findRoute(graph, start, end, engine);
+    serverMetrics.observeSearch(engine, route);
+    return route.toJSON(routeEngineName(engine));
+}
+
+// Compact route: table lookup unless a search engine is requested
+json routeResponse(const GraphState& state, int start, int end, const string& algorithm) {
+    const Graph& graph = state.graph;
+    const DistanceTable& table = state.distanceTable;
+    bool useTable = (algorithm == "table") || (algorithm.empty() && table.ready());
+    if (!useTable) {
+        return searchRoute(graph, start, end, parseRouteEngine(algorithm));
+    }
+    
+    if (!table.ready()) {
+        throw Unavailable("Distance table is not available");
+    }
+    checkNodeId(graph, start);
+    checkNodeId(graph, end);
+    return table.route(start, end).toJSON("table");
+}
+
+// Routes for POST /api/route/batch: table lookups by default, or shared
+// Dijkstra trees with algorithm=dijkstra
+json batchResponse(const GraphState& state, const string& algorithm, string_view body) {
+    if (!algorithm.empty() && algorithm != "table" && algorithm != "dijkstra") {
+        throw invalid_argument("Unknown algorithm: " + algorithm);
+    }
+    if (algorithm == "table" && !state.distanceTable.ready()) {
+        throw Unavailable("Distance table is not available");
+    }
+    vector<RouteQuery> queries = parseRouteBatch(json::parse(body), &state.spatialIndex);
+    const DistanceTable* table = (algorithm == "dijkstra") ? nullptr : &state.distanceTable;
+    return batchRoutes(state.graph, table, queries);
+}
+
+// Walking distances for /api/sort?metric=network, empty when ranking by straight line
+vector<int> sortNetworkDistances(const GraphState& state, const string& metric, int reference) {
+    if (parseSortMetric(metric) != METRIC_NETWORK) return vector<int>();
+    return distancesFrom(state.graph, state.distanceTable, reference);
+}
+
+// Persistent connection limits
+const int KEEP_ALIVE_TIMEOUT_SECONDS = 5;
+const int KEEP_ALIVE_MAX_REQUESTS = 100;
+
+// Requests larger than this are rejected by closing the connection
+const size_t MAX_REQUEST_BYTES = 64 * 1024;
+
+// Connection headers for the end of a response header block
+string connectionHeaders(bool keepAlive) {
+    if (!keepAlive) return "Connection: close\r\n";
+    return "Connection: keep-alive\r\nKeep-Alive: timeout=" + to_string(KEEP_ALIVE_TIMEOUT_SECONDS) +
+           ", max=" + to_string(KEEP_ALIVE_MAX_REQUESTS) + "\r\n";
+}
+
+// Responses depend on these request headers
+const char* VARY_HEADER = "Vary: Accept, Accept-Encoding\r\n";
+
+// Send HTTP response with a status such as "400 Bad Request". extraHeaders
+// are complete "Name: value\r\n" lines.
+void sendStatusResponse(Connection& client, const string& status, const string& content, const string& contentType,
+                        bool keepAlive, const string& extraHeaders = "") {
+    ostringstream header;
+    header << "HTTP/1.1 " << status << "\r\n";
+    header << "Content-Type: " << contentType << "\r\n";
+    header << "Access-Control-Allow-Origin: *\r\n";
+    header << VARY_HEADER;
+    header << extraHeaders;
+    header << "Content-Length: " << content.length() << "\r\n";
+    header << connectionHeaders(keepAlive);
+    header << "\r\n";
+    
+    // Header and body leave in one gathered send, without copying the body
+    string head = header.str();
+    IoSlice parts[2] = {{head.data(), head.size()}, {content.data(), content.size()}};
+    client.send(parts, 2);
+}
+
+// Send HTTP 200 response
+void sendResponse(Connection& client, const string& content, const string& contentType = "application/json",
+                  bool keepAlive = false, const string& extraHeaders = "") {
+    sendStatusResponse(client, "200 OK", content, contentType, keepAlive, extraHeaders);
+}
+
+// Send a body, compressed with the client's preferred encoding if it is large enough
+void sendEncoded(Connection& client, const string& content, const string& contentType, bool keepAlive,
+                 ContentEncoding encoding) {
+    if (encoding == ENCODING_IDENTITY || content.length() < COMPRESS_MIN_BYTES) {
+        sendResponse(client, content, contentType, keepAlive);
+        return;
+    }
+    string encodingHeader = string("Content-Encoding: ") + contentEncodingName(encoding) + "\r\n";
+    sendResponse(client, compressBody(content, encoding), contentType, keepAlive, encodingHeader);
+}
+
+// sendEncoded for a cached body. encoded is its cached compressed form, or
+// empty, in which case the body is compressed now and the result cached
+// next to it, so later hits skip zlib.
+void sendCachedBody(Connection& client, const string& cacheKey, const string& content, string& encoded,
+                    const string& contentType, bool keepAlive, ContentEncoding encoding) {
+    if (encoding == ENCODING_IDENTITY || content.length() < COMPRESS_MIN_BYTES) {
+        sendResponse(client, content, contentType, keepAlive);
+        return;
+    }
+    if (encoded.empty()) {
+        encoded = compressBody(content, encoding);
+        responseCache.putEncoded(cacheKey, encoding, encoded);
+    }
+    string encodingHeader = string("Content-Encoding: ") + contentEncodingName(encoding) + "\r\n";
+    sendResponse(client, encoded, contentType, keepAlive, encodingHeader);
+}
+
+// Send 304 for a conditional request whose ETag still matches
+void sendNotModified(Connection& client, const string& etag, bool keepAlive) {
+    string response = "HTTP/1.1 304 Not Modified\r\n";
+    response += "Access-Control-Allow-Origin: *\r\n";
+    response += VARY_HEADER;
+    response += "ETag: " + etag + "\r\n";
+    response += connectionHeaders(keepAlive);
+    response += "\r\n";
+    client.send(response);
+}
+
+// GET /api/graph as JSON, from the precomputed body. Each encoding carries
+// its own ETag, and a conditional request matches the one it would get.
+void sendGraph(Connection& client, const HttpRequest& request, bool keepAlive, ContentEncoding encoding,
+               const GraphState& state) {
+    const StaticResponse& graph = state.graphResponse;
+    if (graph.body.length() < COMPRESS_MIN_BYTES) encoding = ENCODING_IDENTITY;
+    string etag = encodedETag(graph.etag, encoding);
+    if (etagMatches(request.header("If-None-Match"), etag)) {
+        sendNotModified(client, etag, keepAlive);
+        return;
+    }
+    
+    string headers = "ETag: " + etag + "\r\n";
+    if (encoding == ENCODING_GZIP) {
+        headers += "Content-Encoding: gzip\r\n";
+        sendResponse(client, graph.gzipBody, "application/json", keepAlive, headers);
+    } else if (encoding == ENCODING_DEFLATE) {
+        headers += "Content-Encoding: deflate\r\n";
+        sendResponse(client, graph.deflateBody, "application/json", keepAlive, headers);
+    } else {
+        sendResponse(client, graph.body, "application/json", keepAlive, headers);
+    }
+}
+
+// Streamed bodies are sent in chunks of about this size
+const size_t STREAM_CHUNK_BYTES = 16 * 1024;
+
+// Streamed bodies up to this size are also kept in the response cache
+const size_t MAX_STREAM_CACHE_BYTES = 1024 * 1024;
+
+// Sends everything written to it as an HTTP/1.1 chunked response, optionally
+// compressed on the fly. The status line and headers go out with the first
+// chunk, so nothing is sent if the handler fails before writing. Optionally
+// keeps an uncompressed copy for the cache.
+class ChunkedSocketSink : public JsonSink {
+private:
+    Connection& client;
+    bool keepAlive;
+    ContentEncoding encoding;
+    unique_ptr<Deflater> deflater;
+    string buffer;    // reused between chunks
+    string frame;     // headers and chunk size line
+    bool headersSent;
+    bool failed;
+    string* capture;
+
+    // Send the buffered bytes as one chunk, with the headers first time round.
+    // The last chunk carries the zero-length terminator in the same packet.
+    void flush(bool last) {
+        if (failed) return;
+        
+        frame.clear();
+        if (!headersSent) {
+            frame += "HTTP/1.1 200 OK\r\n";
+            frame += "Content-Type: application/json\r\n";
+            frame += "Access-Control-Allow-Origin: *\r\n";
+            frame += VARY_HEADER;
+            if (deflater) {
+                frame += "Content-Encoding: ";
+                frame += contentEncodingName(encoding);
+                frame += "\r\n";
+            }
+            frame += "Transfer-Encoding: chunked\r\n";
+            frame += connectionHeaders(keepAlive);
+            frame += "\r\n";
+            headersSent = true;
+        }
+        string_view tail;
+        if (!buffer.empty()) {
+            char size[20];
+            snprintf(size, sizeof(size), "%zx\r\n", buffer.length());
+            frame += size;
+            tail = last ? "\r\n0\r\n\r\n" : "\r\n";
+        } else if (last) {
+            tail = "0\r\n\r\n";
+        }
+        
+        IoSlice parts[3] = {{frame.data(), frame.size()}, {buffer.data(), buffer.size()}, {tail.data(), tail.size()}};
+        // Past STREAM_QUEUE_BYTES queued, wait for this client rather than buffer the whole stream
+        if (!client.send(parts, 3) || !client.drainTo(STREAM_QUEUE_BYTES, STREAM_STALL_TIMEOUT_MS)) failed = true;
+        buffer.clear();
+    }
+
+public:
+    ChunkedSocketSink(Connection& client, bool keepAlive, string* capture, ContentEncoding encoding = ENCODING_IDENTITY)
+        : client(client), keepAlive(keepAlive), encoding(encoding),
+          headersSent(false), failed(false), capture(capture) {
+        if (encoding != ENCODING_IDENTITY) deflater.reset(new Deflater(encoding));
+        buffer.reserve(STREAM_CHUNK_BYTES + 4096);
+    }
+
+    void write(string_view data) override {
+        if (capture) {
+            if (capture->length() + data.length() <= MAX_STREAM_CACHE_BYTES) {
+                capture->append(data.data(), data.size());
+            } else {
+                capture->clear();
+                capture = nullptr;
+            }
+        }
+        if (deflater) {
+            deflater->write(data, buffer);
+        } else {
+            buffer.append(data.data(), data.size());
+        }
+        if (buffer.length() >= STREAM_CHUNK_BYTES) flush(false);
+    }
+
+    // Send the rest and the terminating chunk. False if the client went away.
+    bool finish() {
+        if (deflater) deflater->finish(buffer);
+        flush(true);
+        return !failed;
+    }
+
+    bool started() const {
+        return headersSent;
+    }
+
+    // True if the whole body was kept in the capture string
+    bool captured() const {
+        return capture != nullptr;
+    }
+};
+
+// Send 404 error
+void send404(Connection& client, bool keepAlive = false) {
+    string content = "{\"error\": \"Endpoint not found\"}";
     ostringstream response;
-    response << "HTTP/1.1 200 OK\r\n";
-    response << "Content-Type: " << contentType << "\r\n";
+    response << "HTTP/1.1 404 Not Found\r\n";
+    response << "Content-Type: application/json\r\n";
     response << "Access-Control-Allow-Origin: *\r\n";
     response << "Content-Length: " << content.length() << "\r\n";
-    response << "Connection: close\r\n";
+    response << connectionHeaders(keepAlive);
     response << "\r\n";
     response << content;
     
-    string responseStr = response.str();
-    send(clientSocket, responseStr.c_str(), static_cast<int>(responseStr.length()), 0);
+    client.send(response.str());
 }
 
-// Send 404 error
-void send404(int clientSocket) {
-    string content = "{\"error\": \"Endpoint not found\"}";
+// Send 400 error for a request that could not be parsed
+void send400(Connection& client) {
+    string content = "{\"error\": \"Bad request\"}";
     ostringstream response;
-    response << "HTTP/1.1 404 Not Found\r\n";
+    response << "HTTP/1.1 400 Bad Request\r\n";
     response << "Content-Type: application/json\r\n";
     response << "Access-Control-Allow-Origin: *\r\n";
     response << "Content-Length: " << content.length() << "\r\n";
+    response << connectionHeaders(false);
     response << "\r\n";
     response << content;
     
-    string responseStr = response.str();
-    send(clientSocket, responseStr.c_str(), static_cast<int>(responseStr.length()), 0);
+    client.send(response.str());
+}
+
+// Endpoints whose responses depend only on the graph and the parameters
+bool isCacheable(const string& path) {
+    return path == "/api/graph" || path == "/api/dijkstra" || path == "/api/route" ||
+           path == "/api/search" || path == "/api/search/suggest" || path == "/api/sort" ||
+           path == "/api/matrix" || path == "/api/nearest" || path == "/api/nearest/facility";
+}
+
+// Status line for a request that failed with e. Bad parameters and bodies
+// surface as invalid_argument, out_of_range (node ids) or a JSON
+// parse or type error; anything else is the server's fault.
+const char* errorStatus(const exception& e) {
+    if (dynamic_cast<const invalid_argument*>(&e) || dynamic_cast<const out_of_range*>(&e) ||
+        dynamic_cast<const json::exception*>(&e)) {
+        return "400 Bad Request";
+    }
+    if (dynamic_cast<const Unavailable*>(&e)) return "503 Service Unavailable";
+    return "500 Internal Server Error";
+}
+
+// The parameters a cacheable endpoint's response depends on, each parsed the
+// way the handler parses it and written back in one canonical form, with
+// defaults filled in and anything else dropped. start=01 and start=1, or an
+// explicit default and none, then share one cache entry. Throws if a
+// parameter does not parse; such requests are answered uncached.
+map<string, string> cacheKeyParams(const GraphState& state, const string& path, const map<string, string>& params) {
+    auto get = [&](const string& key) { return paramValue(params, key); };
+    auto integer = [&](const string& key) { return to_string(intParam(params, key)); };
+    auto number = [&](const string& key) { return json(numberParam(params, key)).dump(); };
+    auto traceParams = [&](map<string, string>& key) {
+        key["trace"] = traceFormatName(parseTraceFormat(get("trace")));
+        key["text"] = parseTraceText(get("text")) ? "1" : "0";
+    };
+    // Table-backed endpoints: no algorithm means the table when it answers,
+    // else a search; an explicit "table" stays, so it still fails when the
+    // table is unavailable instead of hitting a search result
+    auto tableOrSearch = [&](bool tableAnswers) {
+        string algorithm = get("algorithm");
+        if (algorithm.empty()) return string(tableAnswers ? "table" : "dijkstra");
+        if (algorithm != "table" && algorithm != "dijkstra") throw invalid_argument("Unknown algorithm: " + algorithm);
+        return algorithm;
+    };
+    
+    map<string, string> key;
+    if (path == "/api/graph") {
+        // no parameters
+    } else if (path == "/api/dijkstra") {
+        key["start"] = integer("start");
+        key["end"] = integer("end");
+        RouteEngine engine = parseRouteEngine(get("algorithm"));
+        key["algorithm"] = routeEngineName(engine);
+        if (get("mode") == "fast" || engine == ENGINE_BIDIRECTIONAL) {
+            key["mode"] = "fast";
+        } else {
+            traceParams(key);
+        }
+    } else if (path == "/api/route") {
+        key["start"] = integer("start");
+        key["end"] = integer("end");
+        string algorithm = get("algorithm");
+        if (algorithm.empty() || algorithm == "table") {
+            key["algorithm"] = tableOrSearch(state.distanceTable.ready());
+        } else {
+            key["algorithm"] = routeEngineName(parseRouteEngine(algorithm));
+        }
+    } else if (path == "/api/search") {
+        key["query"] = get("query");
+        key["text"] = parseTraceText(get("text")) ? "1" : "0";
+    } else if (path == "/api/search/suggest") {
+        key["query"] = get("query");
+        key["limit"] = get("limit").empty() ? "10" : integer("limit");
+    } else if (path == "/api/sort") {
+        key["reference"] = integer("reference");
+        key["metric"] = parseSortMetric(get("metric")) == METRIC_NETWORK ? "network" : "euclidean";
+        if (get("mode") == "fast") {
+            key["mode"] = "fast";
+            key["k"] = get("k").empty() ? "0" : integer("k");
+        } else {
+            traceParams(key);
+        }
+    } else if (path == "/api/matrix") {
+        key["sources"] = json(parseIdList(get("sources"))).dump();
+        key["targets"] = get("targets").empty() ? "all" : json(parseIdList(get("targets"))).dump();
+        key["algorithm"] = tableOrSearch(state.distanceTable.ready());
+    } else if (path == "/api/nearest") {
+        key["x"] = number("x");
+        key["y"] = number("y");
+        if (!get("radius").empty()) key["radius"] = number("radius");
+        key["k"] = !get("k").empty() ? integer("k") : get("radius").empty() ? "1" : to_string(MAX_NEAREST_RESULTS);
+        key["type"] = get("type");
+    } else if (path == "/api/nearest/facility") {
+        key["source"] = integer("source");
+        key["type"] = get("type");
+        key["k"] = get("k").empty() ? "1" : integer("k");
+        key["algorithm"] = tableOrSearch(key["k"] == "1" && state.facilityTable.ready());
+    } else {
+        key = params;
+    }
+    return key;
+}
+
+// Compute the result for an API endpoint, false if the endpoint is unknown
+bool buildResponse(const GraphState& state, const string& path, map<string, string>& params, json& result) {
+    const Graph& graph = state.graph;
+    
+    // GET /api/cache - Response cache statistics
+    if (path == "/api/cache") {
+        result = responseCache.stats();
+    }
+    
+    // GET /api/graph - Return campus graph data
+    else if (path == "/api/graph") {
+        result = graphJSON(graph);
+    }
+    
+    // GET /api/dijkstra?start=0&end=9[&algorithm=astar|bidirectional][&mode=fast][&trace=delta][&text=1]
+    else if (path == "/api/dijkstra") {
+        int start = intParam(params, "start");
+        int end = intParam(params, "end");
+        RouteEngine engine = parseRouteEngine(params["algorithm"]);
+        
+        // The bidirectional engine has no visual trace
+        if (params["mode"] == "fast" || engine == ENGINE_BIDIRECTIONAL) {
+            result = searchRoute(graph, start, end, engine);
+        } else {
+            checkNodeId(graph, start);
+            checkNodeId(graph, end);
+            TraceFormat format = parseTraceFormat(params["trace"]);
+            bool withText = parseTraceText(params["text"]);
+            result = (engine == ENGINE_ASTAR)
+                ? getAStarPath(graph, start, end, format, withText)
+                : getDijkstraPath(graph, start, end, format, withText);
+        }
+    }
+    
+    // GET /api/route?start=0&end=9[&algorithm=table|dijkstra|astar|bidirectional]
+    // Path and distance only, no trace. Uses the distance table by default.
+    else if (path == "/api/route") {
+        int start = intParam(params, "start");
+        int end = intParam(params, "end");
+        
+        result = routeResponse(state, start, end, params["algorithm"]);
+    }
+    
+    // GET /api/search?query=Library[&text=1]
+    else if (path == "/api/search") {
+        string query = params["query"];
+        
+        result = searchBuilding(graph, query, parseTraceText(params["text"]));
+    }
+    
+    // GET /api/search/suggest?query=lib[&limit=10] - typeahead, case-insensitive and typo tolerant
+    else if (path == "/api/search/suggest") {
+        string query = params["query"];
+        int limit = params["limit"].empty() ? 10 : intParam(params, "limit");
+        
+        result = suggestBuildings(graph, query, limit);
+    }
+    
+    // GET /api/sort?reference=0[&metric=network][&trace=delta][&text=1][&mode=fast[&k=10]]
+    // mode=fast ranks without a trace (radix or parallel sort, or top-k for the k closest)
+    else if (path == "/api/sort") {
+        int reference = intParam(params, "reference");
+        checkNodeId(graph, reference);
+        vector<int> network = sortNetworkDistances(state, params["metric"], reference);
+        const vector<int>* networkDistances = network.empty() ? nullptr : &network;
+        
+        if (params["mode"] == "fast") {
+            int k = params["k"].empty() ? 0 : intParam(params, "k");
+            result = rankLocationsByDistance(graph, reference, k, networkDistances);
+        } else {
+            TraceFormat format = parseTraceFormat(params["trace"]);
+            result = sortLocationsByDistance(graph, reference, format, networkDistances,
+                                             parseTraceText(params["text"]));
+        }
+    }
+    
+    // GET /api/matrix?sources=0,1&targets=5,9[&algorithm=table|dijkstra]
+    // Network distances sources x targets, -1 if unreachable; all nodes if targets is omitted
+    else if (path == "/api/matrix") {
+        vector<int> sources = parseIdList(params["sources"]);
+        vector<int> targets = parseIdList(params["targets"]);
+        if (sources.empty()) throw invalid_argument("sources is required");
+        if (params["targets"].empty()) {
+            for (int v = 0; v < graph.size(); v++) targets.push_back(v);
+        }
+        
+        string algorithm = params["algorithm"];
+        if (!algorithm.empty() && algorithm != "table" && algorithm != "dijkstra") {
+            throw invalid_argument("Unknown algorithm: " + algorithm);
+        }
+        if (algorithm == "table" && !state.distanceTable.ready()) {
+            throw Unavailable("Distance table is not available");
+        }
+        const DistanceTable* table = (algorithm == "dijkstra") ? nullptr : &state.distanceTable;
+        result = computeDistanceMatrix(graph, table, sources, targets).toJSON();
+    }
+    
+    // GET /api/nearest?x=400&y=300[&k=5][&radius=300][&type=food]
+    // Closest nodes by straight-line distance; k defaults to 1, or to every
+    // node in range when a radius is given
+    else if (path == "/api/nearest") {
+        if (params["x"].empty() || params["y"].empty()) throw invalid_argument("x and y are required");
+        double x = numberParam(params, "x");
+        double y = numberParam(params, "y");
+        double radius = params["radius"].empty() ? INFINITY : numberParam(params, "radius");
+        int k = !params["k"].empty() ? intParam(params, "k") : params["radius"].empty() ? 1 : MAX_NEAREST_RESULTS;
+        
+        result = nearestNodes(graph, state.spatialIndex, x, y, k, radius, params["type"]);
+    }
+    
+    // GET /api/nearest/facility?source=0&type=cafeteria[&k=3][&algorithm=table|dijkstra]
+    // Closest nodes of a type by walking distance, with their paths
+    else if (path == "/api/nearest/facility") {
+        int source = intParam(params, "source");
+        int k = params["k"].empty() ? 1 : intParam(params, "k");
+        
+        result = nearestFacilityResponse(graph, state.facilityTable, source, params["type"], k, params["algorithm"]);
+    }
+    
+    // Unknown endpoint
+    else {
+        return false;
+    }
+    return true;
+}
+
+// Serialize a trace endpoint straight into a sink as it is computed.
+// Returns false, without writing anything, for responses that are not streamed.
+bool streamResponse(const GraphState& state, const string& path, map<string, string>& params, JsonSink& sink) {
+    const Graph& graph = state.graph;
+    JsonWriter out(sink);
+    
+    // GET /api/dijkstra with a visual trace
+    if (path == "/api/dijkstra") {
+        int start = intParam(params, "start");
+        int end = intParam(params, "end");
+        RouteEngine engine = parseRouteEngine(params["algorithm"]);
+        if (params["mode"] == "fast" || engine == ENGINE_BIDIRECTIONAL) return false;
+        
+        checkNodeId(graph, start);
+        checkNodeId(graph, end);
+        TraceFormat format = parseTraceFormat(params["trace"]);
+        streamDijkstraPath(graph, start, end, format, engine == ENGINE_ASTAR, parseTraceText(params["text"]), out);
+        return true;
+    }
+    
+    // GET /api/sort with a visual trace
+    if (path == "/api/sort") {
+        if (params["mode"] == "fast") return false;
+        int reference = intParam(params, "reference");
+        checkNodeId(graph, reference);
+        TraceFormat format = parseTraceFormat(params["trace"]);
+        vector<int> network = sortNetworkDistances(state, params["metric"], reference);
+        streamLocationsByDistance(graph, reference, format, out, network.empty() ? nullptr : &network,
+                                  parseTraceText(params["text"]));
+        return true;
+    }
+    
+    return false;
+}
+
+// GET /api/metrics: request metrics plus the response cache and graph
+string metricsText() {
+    string text = serverMetrics.render();
+    unsigned long long hits = responseCache.hitCount();
+    unsigned long long misses = responseCache.missCount();
+    json cache = responseCache.stats();
+    appendMetric(text, "campus_cache_hits_total", "counter", "Response cache hits", hits);
+    appendMetric(text, "campus_cache_misses_total", "counter", "Response cache misses", misses);
+    appendMetric(text, "campus_cache_hit_ratio", "gauge", "Share of cache lookups that hit",
+                 hits + misses > 0 ? double(hits) / (hits + misses) : 0);
+    appendMetric(text, "campus_cache_entries", "gauge", "Cached response bodies", cache["entries"].get<double>());
+    appendMetric(text, "campus_cache_bytes", "gauge", "Bytes held by the response cache", cache["bytes"].get<double>());
+    appendMetric(text, "campus_graph_version", "gauge", "Version of the published graph", currentGraph()->version);
+    return text;
 }
 
-// Handle API requests
-void handleRequest(int clientSocket, const string& request) {
-    string path = extractPath(request);
-    string queryString = extractQueryString(request);
-    map<string, string> params = parseQueryParams(queryString);
+// Handle API requests. Returns false if the connection can no longer be
+// used, e.g. when a streamed response failed halfway. parseSeconds is the
+// time spent parsing the request, for the latency metrics.
+bool handleRequest(Connection& client, const HttpRequest& request, bool keepAlive = false, double parseSeconds = 0) {
+    string path(request.path);
+    RequestTimer timer(serverMetrics, path, parseSeconds);
+    map<string, string> params = parseQueryParams(request.query);
     
-    cout << "Request: " << path << endl;
+    serverLog.info("Request: " + path);
+    
+    // Response encoding from ?format=json|msgpack|cbor or the Accept header
+    WireFormat wire = WIRE_JSON;
     
     try {
-        // GET /api/graph - Return campus graph data
-        if (path == "/api/graph") {
-            json graphData;
-            graphData["nodes"] = json::array();
-            graphData["edges"] = json::array();
-            
-            for (const auto& node : campusGraph.getNodes()) {
-                graphData["nodes"].push_back({
-                    {"id", node.id},
-                    {"name", node.name},
-                    {"x", node.x},
-                    {"y", node.y},
-                    {"type", node.type}
-                });
-            }
-            
-            for (const auto& edge : campusGraph.getEdges()) {
-                graphData["edges"].push_back({
-                    {"from", edge.from},
-                    {"to", edge.to},
-                    {"weight", edge.weight},
-                    {"type", edge.pathType}
-                });
-            }
-            
-            sendResponse(clientSocket, graphData.dump());
+        wire = negotiateWireFormat(params["format"], request.header("Accept"));
+        params.erase("format");
+        const char* contentType = wireContentType(wire);
+        ContentEncoding encoding = acceptedEncoding(request.header("Accept-Encoding"));
+        timer.mark(PHASE_PARSE);
+        
+        // GET /api/metrics - Prometheus text format, never cached
+        if (path == "/api/metrics") {
+            string text = metricsText();
+            timer.mark(PHASE_SERIALIZE);
+            sendEncoded(client, text, "text/plain; version=0.0.4; charset=utf-8", keepAlive, encoding);
+            timer.mark(PHASE_SEND);
+            return true;
         }
         
-        // GET /api/dijkstra?start=0&end=9
-        else if (path == "/api/dijkstra") {
-            int start = stoi(params["start"]);
-            int end = stoi(params["end"]);
-            
-            json result = getDijkstraPath(campusGraph, start, end);
-            sendResponse(clientSocket, result.dump());
+        // POST /api/edges/add|remove|weight - publishes a new graph version
+        if (isGraphUpdate(path)) {
+            if (request.method != "POST") throw invalid_argument(path + " requires POST");
+            json result = updateGraph(path, params);
+            timer.mark(PHASE_COMPUTE);
+            string body = encodeBody(result, wire);
+            timer.mark(PHASE_SERIALIZE);
+            sendResponse(client, body, contentType, keepAlive);
+            timer.mark(PHASE_SEND);
+            return true;
         }
         
-        // GET /api/search?query=Library
-        else if (path == "/api/search") {
-            string query = params["query"];
-            
-            json result = searchBuilding(campusGraph, query);
-            sendResponse(clientSocket, result.dump());
+        // The whole request is answered from this version, even if the graph changes meanwhile
+        shared_ptr<const GraphState> state = currentGraph();
+        snapRouteParams(*state, path, params);
+        
+        if (path == "/api/graph" && wire == WIRE_JSON) {
+            sendGraph(client, request, keepAlive, encoding, *state);
+            timer.mark(PHASE_SEND);
+            return true;
+        }
+        
+        // POST /api/route/batch[?algorithm=table|dijkstra] with body [[start,end], ...]
+        if (path == "/api/route/batch") {
+            if (request.method != "POST") throw invalid_argument(path + " requires POST");
+            json result = batchResponse(*state, params["algorithm"], request.body);
+            timer.mark(PHASE_COMPUTE);
+            string body = encodeBody(result, wire);
+            timer.mark(PHASE_SERIALIZE);
+            sendEncoded(client, body, contentType, keepAlive, encoding);
+            timer.mark(PHASE_SEND);
+            return true;
         }
         
-        // GET /api/sort?reference=0
-        else if (path == "/api/sort") {
-            int reference = stoi(params["reference"]);
+        string body;
+        string cacheKey;
+        bool cacheable = isCacheable(path);
+        
+        if (cacheable) {
+            try {
+                cacheKey = to_string(state->version) + ':' + makeCacheKey(path, cacheKeyParams(*state, path, params));
+            } catch (const exception&) {
+                cacheable = false;   // the handler reports what is wrong
+            }
+        }
+        if (cacheable) {
+            if (wire != WIRE_JSON) {
+                cacheKey += '#';
+                cacheKey += wireFormatName(wire);
+            }
+            string encoded;
+            if (responseCache.get(cacheKey, encoding, body, encoded)) {
+                timer.mark(PHASE_COMPUTE);
+                sendCachedBody(client, cacheKey, body, encoded, contentType, keepAlive, encoding);
+                timer.mark(PHASE_SEND);
+                return true;
+            }
+        }
+        
+        // JSON traces go out chunked while they are serialized (chunked needs HTTP/1.1).
+        // MessagePack needs every array length up front, so binary traces are
+        // built in memory; the client asks for JSON traces by default.
+        if (wire == WIRE_JSON && request.version == "HTTP/1.1") {
+            ChunkedSocketSink sink(client, keepAlive, cacheable ? &body : nullptr, encoding);
+            bool streamed;
+            try {
+                streamed = streamResponse(*state, path, params, sink);
+            } catch (const exception& e) {
+                if (sink.started()) {
+                    timer.fail();
+                    serverLog.warn("Streamed response for " + path + " failed: " + e.what());
+                    return false;
+                }
+                throw;
+            }
             
-            json result = sortLocationsByDistance(campusGraph, reference);
-            sendResponse(clientSocket, result.dump());
+            if (streamed) {
+                bool finished = sink.finish();
+                timer.mark(PHASE_COMPUTE);   // serialized and sent while computing
+                if (!finished) return false;
+                if (cacheable && sink.captured()) {
+                    responseCache.put(cacheKey, body);
+                }
+                return true;
+            }
+            body.clear();
+        }
+        
+        json result;
+        if (!buildResponse(*state, path, params, result)) {
+            send404(client, keepAlive);
+            timer.mark(PHASE_SEND);
+            return true;
         }
+        timer.mark(PHASE_COMPUTE);
+        body = encodeBody(result, wire);
+        timer.mark(PHASE_SERIALIZE);
         
-        // Unknown endpoint
-        else {
-            send404(clientSocket);
+        if (cacheable) {
+            responseCache.put(cacheKey, body);
+            string encoded;
+            sendCachedBody(client, cacheKey, body, encoded, contentType, keepAlive, encoding);
+        } else {
+            sendEncoded(client, body, contentType, keepAlive, encoding);
         }
+        timer.mark(PHASE_SEND);
     }
     catch (const exception& e) {
+        timer.fail();
+        timer.mark(PHASE_COMPUTE);
+        if (serverLog.enabled(LOG_DEBUG)) serverLog.debug("Error on " + path + ": " + e.what());
         json error;
         error["error"] = e.what();
-        sendResponse(clientSocket, error.dump());
+        sendStatusResponse(client, errorStatus(e), encodeBody(error, wire), wireContentType(wire), keepAlive);
+        timer.mark(PHASE_SEND);
     }
+    return true;
 }
 
-int main() {
-    // Initialize Winsock
-    WSADATA wsaData;
-    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
-        cerr << "WSAStartup failed" << endl;
-        WSACleanup();
-        return 1;
-    }
-
-    SOCKET serverSocket = socket(AF_INET, SOCK_STREAM, 0);
-    if (serverSocket == INVALID_SOCKET) {
-        cerr << "Error creating socket: " << WSAGetLastError() << endl;
-        WSACleanup();
-        return 1;
+// Read what has arrived on a connection and answer every complete request
+// in it, in order. Returns false when the connection should be closed: the
+// client closed it or asked to, a request was malformed or too large, a
+// streamed response failed, or the per-connection limit was reached.
+// Runs on a worker thread.
+bool serveConnection(Connection& connection) {
+    bool peerClosed = false;
+    char buffer[16 * 1024];
+    while (connection.pending.length() <= MAX_REQUEST_BYTES) {
+        int n = receiveSome(connection.socket, buffer, sizeof(buffer));
+        if (n > 0) {
+            connection.pending.append(buffer, n);
+            continue;
+        }
+        peerClosed = (n != NET_WOULD_BLOCK);
+        break;
     }
     
-    // Allow socket reuse
-    int opt = 1;
-    setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt));
+    size_t offset = 0;   // requests before it are answered
+    bool open = true;
+    while (open) {
+        HttpRequest request;
+        auto parseBegin = chrono::steady_clock::now();
+        ParseStatus status = connection.parser.parse(string_view(connection.pending).substr(offset), request);
+        double parseSeconds = chrono::duration<double>(chrono::steady_clock::now() - parseBegin).count();
+        
+        if (status == PARSE_ERROR) {
+            send400(connection);
+            return false;
+        }
+        
+        if (status == PARSE_INCOMPLETE) {
+            if (connection.pending.length() - offset > MAX_REQUEST_BYTES) {
+                send400(connection);
+                return false;
+            }
+            break;
+        }
+        
+        connection.served++;
+        bool keepAlive = request.keepAlive() && connection.served < KEEP_ALIVE_MAX_REQUESTS;
+        bool usable = handleRequest(connection, request, keepAlive, parseSeconds);
+        requestArena().reset();   // the response is out: drop its trace data at once
+        
+        offset += request.length;
+        connection.parser.reset();
+        open = keepAlive && usable;
+        
+        // The client is not reading: leave further pipelined requests until the loop has sent this
+        if (connection.unsent() > STREAM_QUEUE_BYTES) break;
+    }
     
-    sockaddr_in serverAddr;
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_addr.s_addr = INADDR_ANY;
-    serverAddr.sin_port = htons(8080);
+    // Drop answered requests; a partial one waits for more bytes
+    if (offset > 0) {
+        connection.pending.erase(0, offset);
+        connection.parser.reset();
+    }
+    return open && !peerClosed;
+}
+
+int main(int argc, char* argv[]) {
+    int workerThreads = defaultThreadCount();
+    Graph initialGraph = createCampusGraph();   // built-in map unless --graph names a file
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--no-precompute") {
+            precomputeEnabled = false;
+        } else if (arg == "--cache-mb" && i + 1 < argc) {
+            responseCache.setCapacity(stoul(argv[++i]) * 1024 * 1024);
+        } else if (arg == "--log-level" && i + 1 < argc) {
+            try {
+                serverLog.setLevel(parseLogLevel(argv[++i]));
+            }
+            catch (const exception& e) {
+                cerr << e.what() << endl;
+                return 1;
+            }
+        } else if (arg == "--threads" && i + 1 < argc) {
+            string value = argv[++i];
+            try {
+                size_t used;
+                workerThreads = stoi(value, &used);
+                if (used != value.size() || workerThreads < 1) throw invalid_argument(value);
+            }
+            catch (const exception&) {
+                cerr << "--threads needs a positive number, got: " << value << endl;
+                return 1;
+            }
+        } else if (arg == "--graph" && i + 1 < argc) {
+            string graphFile = argv[++i];
+            try {
+                auto begin = chrono::steady_clock::now();
+                initialGraph = loadGraph(graphFile);
+                cout << "Loaded " << graphFile << ": " << initialGraph.size() << " nodes, "
+                     << initialGraph.getEdges().size() << " edges in "
+                     << chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count() << " ms" << endl;
+            }
+            catch (const exception& e) {
+                cerr << "Cannot load graph: " << e.what() << endl;
+                return 1;
+            }
+        }
+    }
+    publishGraph(move(initialGraph));
     
-    if (bind(serverSocket, (sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
-        cerr << "Error binding socket: " << WSAGetLastError() << endl;
-        closesocket(serverSocket);
-        WSACleanup();
+    if (!netStartup()) {
+        cerr << "Network startup failed" << endl;
         return 1;
     }
     
-    if (listen(serverSocket, 10) == SOCKET_ERROR) {
-        cerr << "Error listening: " << WSAGetLastError() << endl;
-        closesocket(serverSocket);
-        WSACleanup();
+    string listenError;
+    socket_t serverSocket = openListener(8080, listenError);
+    if (serverSocket == NO_SOCKET) {
+        cerr << listenError << endl;
+        netCleanup();
         return 1;
     }
     
@@ -167,34 +1121,42 @@ int main() {
     cout << "Server running on http://localhost:8080" << endl;
     cout << "Endpoints:" << endl;
     cout << "  GET /api/graph" << endl;
-    cout << "  GET /api/dijkstra?start=0&end=9" << endl;
-    cout << "  GET /api/search?query=Library" << endl;
-    cout << "  GET /api/sort?reference=0" << endl;
+    cout << "  GET /api/dijkstra?start=0&end=9[&algorithm=astar|bidirectional][&mode=fast][&trace=delta][&text=1]" << endl;
+    cout << "  GET /api/route?start=0&end=9[&algorithm=table|dijkstra|astar|bidirectional]" << endl;
+    cout << "      (start/end may also be x,y coordinates, snapped to the nearest node)" << endl;
+    cout << "  GET /api/nearest?x=400&y=300[&k=5][&radius=300][&type=food]" << endl;
+    cout << "  GET /api/nearest/facility?source=0&type=cafeteria[&k=3][&algorithm=table|dijkstra]" << endl;
+    cout << "  GET /api/search?query=Library[&text=1]" << endl;
+    cout << "  GET /api/search/suggest?query=lib[&limit=10]" << endl;
+    cout << "  POST /api/route/batch[?algorithm=table|dijkstra]  body: [[0,9],[3,5],...]" << endl;
+    cout << "  GET /api/sort?reference=0[&metric=network][&trace=delta][&text=1][&mode=fast[&k=10]]" << endl;
+    cout << "  GET /api/matrix?sources=0,1&targets=5,9[&algorithm=table|dijkstra]" << endl;
+    cout << "  GET /api/cache" << endl;
+    cout << "  GET /api/metrics  (Prometheus text format)" << endl;
+    cout << "  POST /api/edges/add?from=0&to=9&weight=300[&type=walkway]" << endl;
+    cout << "  POST /api/edges/remove?from=0&to=1" << endl;
+    cout << "  POST /api/edges/weight?from=0&to=1&weight=500" << endl;
+    cout << "Response format: JSON, or [&format=msgpack|cbor] / Accept: application/msgpack|application/cbor" << endl;
+    cout << "Distance table: ";
+    shared_ptr<const GraphState> state = currentGraph();
+    if (state->distanceTable.ready()) {
+        cout << state->distanceTable.strategyName() << ", " << state->graph.size() << " nodes, "
+             << state->distanceTable.buildTimeMillis() << " ms, "
+             << state->distanceTable.memoryBytes() / 1024.0 << " KB" << endl;
+    } else {
+        cout << (precomputeEnabled ? "skipped (graph too large)" : "disabled") << endl;
+    }
+    
+    ThreadPool workers(workerThreads);
+    ConnectionLoop loop(workers, serverLog, serverMetrics.connectionsInFlight, KEEP_ALIVE_TIMEOUT_SECONDS,
+                        serveConnection);
+    cout << "Worker threads: " << workers.size() << endl;
+    cout << "Event loop: " << ConnectionLoop::backendName() << endl;
     cout << "========================================" << endl;
     
-    while (true) {
-        sockaddr_in clientAddr;
-        int clientLen = sizeof(clientAddr);
-        
-        SOCKET clientSocket = accept(serverSocket, (sockaddr*)&clientAddr, &clientLen);
-        
-        if (clientSocket == INVALID_SOCKET) {
-            cerr << "Error accepting connection: " << WSAGetLastError() << endl;
-            continue;
-        }
-        
-        char buffer[4096] = {0};
-        int bytesRead = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
-        
-        if (bytesRead > 0) {
-            string request(buffer);
-            handleRequest(clientSocket, request);
-        }
-        
-        closesocket(clientSocket);
-    }
+    loop.run(serverSocket);
     
-    closesocket(serverSocket);
-    WSACleanup();
+    closeSocket(serverSocket);
+    netCleanup();
     return 0;
 }
\ No newline at end of file
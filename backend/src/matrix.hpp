@@ -0,0 +1,140 @@
+#pragma once
+#include "graph.hpp"
+#include "indexed_heap.hpp"
+#include "route.hpp"
+#include "search_workspace.hpp"
+#include "distance_table.hpp"
+#include "thread_pool.hpp"
+#include "../lib/json.hpp"
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+using json = nlohmann::json;
+using namespace std;
+
+// Largest sources x targets matrix one request may ask for
+const size_t MAX_MATRIX_CELLS = 1000000;
+
+// Network distances from source to every node (INF if unreachable)
+vector<int> singleSourceDistances(const Graph& graph, int source) {
+    int n = graph.size();
+    vector<int> dist(n, INF);
+    vector<bool> visited(n, false);
+
+    IndexedHeap pq(n);
+    dist[source] = 0;
+    pq.push(source, 0);
+
+    while (!pq.empty()) {
+        int u = pq.pop().second;
+        visited[u] = true;
+
+        for (const auto& adj : graph.neighbors(u)) {
+            int newDist = dist[u] + adj.weight;
+            if (!visited[adj.to] && newDist < dist[adj.to]) {
+                dist[adj.to] = newDist;
+                pq.push(adj.to, newDist);
+            }
+        }
+    }
+    return dist;
+}
+
+// Network distances from source to each of targets, in their order (INF if
+// unreachable). The search stops as soon as all of them are settled.
+vector<int> distancesToTargets(const Graph& graph, int source, const vector<int>& targets) {
+    vector<int> wanted(targets);
+    sort(wanted.begin(), wanted.end());
+    wanted.erase(unique(wanted.begin(), wanted.end()), wanted.end());
+    size_t remaining = wanted.size();
+
+    SearchWorkspace& ws = threadWorkspace();
+    ws.begin(graph.size());
+    IndexedHeap& pq = ws.heap;
+    ws.reach(source, 0, -1);
+    pq.push(source, 0);
+
+    while (!pq.empty() && remaining > 0) {
+        int u = pq.pop().second;
+        ws.settle(u);
+        if (binary_search(wanted.begin(), wanted.end(), u)) remaining--;
+
+        int distU = ws.distance(u);
+        for (const auto& adj : graph.neighbors(u)) {
+            int newDist = distU + adj.weight;
+            if (!ws.settled(adj.to) && newDist < ws.distance(adj.to)) {
+                ws.reach(adj.to, newDist, u);
+                pq.push(adj.to, newDist);
+            }
+        }
+    }
+
+    vector<int> dist(targets.size());
+    for (size_t j = 0; j < targets.size(); j++) dist[j] = ws.distance(targets[j]);
+    return dist;
+}
+
+// Distances from source to every node, from the table if it is ready
+vector<int> distancesFrom(const Graph& graph, const DistanceTable& table, int source) {
+    if (!table.ready()) return singleSourceDistances(graph, source);
+
+    vector<int> dist(graph.size());
+    for (int v = 0; v < graph.size(); v++) dist[v] = table.distance(source, v);
+    return dist;
+}
+
+// Network distance matrix, one row per source; -1 marks unreachable pairs.
+// Without a ready table, one truncated Dijkstra per source runs in parallel.
+struct DistanceMatrix {
+    vector<int> sources;
+    vector<int> targets;
+    vector<vector<int>> distances;
+    bool fromTable;
+    int threads;
+
+    DistanceMatrix() : fromTable(false), threads(0) {}
+
+    json toJSON() const {
+        json result;
+        result["sources"] = sources;
+        result["targets"] = targets;
+        result["distances"] = distances;
+        result["algorithm"] = fromTable ? "table" : "dijkstra";
+        if (!fromTable) result["threads"] = threads;
+        return result;
+    }
+};
+
+DistanceMatrix computeDistanceMatrix(const Graph& graph, const DistanceTable* table,
+                                     const vector<int>& sources, const vector<int>& targets) {
+    for (int s : sources) checkNodeId(graph, s);
+    for (int t : targets) checkNodeId(graph, t);
+    if (sources.size() * targets.size() > MAX_MATRIX_CELLS) {
+        throw invalid_argument("Matrix too large: at most " + to_string(MAX_MATRIX_CELLS) + " cells");
+    }
+
+    DistanceMatrix matrix;
+    matrix.sources = sources;
+    matrix.targets = targets;
+    matrix.distances.assign(sources.size(), vector<int>(targets.size(), -1));
+
+    if (table && table->ready()) {
+        matrix.fromTable = true;
+        for (size_t i = 0; i < sources.size(); i++) {
+            for (size_t j = 0; j < targets.size(); j++) {
+                int d = table->distance(sources[i], targets[j]);
+                if (d != INF) matrix.distances[i][j] = d;
+            }
+        }
+        return matrix;
+    }
+
+    matrix.threads = parallelFor(sources.size(), [&](size_t i) {
+        vector<int> dist = distancesToTargets(graph, sources[i], targets);
+        for (size_t j = 0; j < targets.size(); j++) {
+            if (dist[j] != INF) matrix.distances[i][j] = dist[j];
+        }
+    });
+    return matrix;
+}
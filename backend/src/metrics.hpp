@@ -0,0 +1,274 @@
+#pragma once
+#include "route.hpp"
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <cstdint>
+
+using namespace std;
+
+// Endpoints with their own series; every other path is counted as "other"
+const char* const METRIC_ROUTES[] = {
+    "/api/graph", "/api/dijkstra", "/api/route", "/api/route/batch", "/api/matrix",
+    "/api/search", "/api/search/suggest", "/api/sort", "/api/nearest", "/api/nearest/facility",
+    "/api/cache", "/api/metrics", "/api/edges/add", "/api/edges/remove", "/api/edges/weight",
+    "other"
+};
+const int METRIC_ROUTE_COUNT = sizeof(METRIC_ROUTES) / sizeof(METRIC_ROUTES[0]);
+
+int metricRoute(const string& path) {
+    for (int i = 0; i < METRIC_ROUTE_COUNT - 1; i++) {
+        if (path == METRIC_ROUTES[i]) return i;
+    }
+    return METRIC_ROUTE_COUNT - 1;
+}
+
+// Parts of a request's latency. Streamed traces are written while they are
+// computed, so their serialize and send time is counted as compute.
+enum RequestPhase {
+    PHASE_PARSE,       // HTTP parsing and query decoding
+    PHASE_COMPUTE,     // graph searches, cache lookups, streamed traces
+    PHASE_SERIALIZE,   // JSON / msgpack / CBOR encoding
+    PHASE_SEND,        // compression and writing to the socket
+    PHASE_TOTAL,
+    PHASE_COUNT
+};
+const char* const PHASE_NAMES[PHASE_COUNT] = {"parse", "compute", "serialize", "send", "total"};
+
+// Upper bounds of the latency buckets, in seconds
+const double LATENCY_BUCKETS[] = {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+                                  0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10};
+const int LATENCY_BUCKET_COUNT = sizeof(LATENCY_BUCKETS) / sizeof(LATENCY_BUCKETS[0]);
+
+// Upper bounds of the buckets for nodes settled and heap pushes per search
+const double SEARCH_BUCKETS[] = {10, 100, 1000, 10000, 100000, 1000000, 10000000};
+const int SEARCH_BUCKET_COUNT = sizeof(SEARCH_BUCKETS) / sizeof(SEARCH_BUCKETS[0]);
+
+const int ROUTE_ENGINE_COUNT = 3;   // RouteEngine values
+
+// A shard has a single writer, its own thread, so a relaxed load and store
+// is enough: no locked read-modify-write on the request path
+inline void bump(atomic<uint64_t>& counter, uint64_t by = 1) {
+    counter.store(counter.load(memory_order_relaxed) + by, memory_order_relaxed);
+}
+
+// Counts of one histogram series. Buckets hold the observations that fell
+// in them (the last one is +Inf); they are made cumulative when rendered.
+template <int N>
+struct Histogram {
+    atomic<uint64_t> buckets[N + 1] = {};
+    atomic<uint64_t> count = {0};
+    atomic<double> sum = {0};
+
+    void observe(double value, const double* bounds) {
+        int b = 0;
+        while (b < N && value > bounds[b]) b++;
+        bump(buckets[b]);
+        bump(count);
+        sum.store(sum.load(memory_order_relaxed) + value, memory_order_relaxed);
+    }
+};
+
+// One thread's counters
+struct MetricsShard {
+    atomic<uint64_t> requests[METRIC_ROUTE_COUNT] = {};
+    atomic<uint64_t> errors[METRIC_ROUTE_COUNT] = {};
+    Histogram<LATENCY_BUCKET_COUNT> latency[METRIC_ROUTE_COUNT][PHASE_COUNT];
+    Histogram<SEARCH_BUCKET_COUNT> settled[ROUTE_ENGINE_COUNT];
+    Histogram<SEARCH_BUCKET_COUNT> pushes[ROUTE_ENGINE_COUNT];
+};
+
+// Server metrics in Prometheus text format. Counters live in per-thread
+// shards that are only summed when /api/metrics is read, so recording never
+// contends between connection workers. There is one instance per process.
+class Metrics {
+private:
+    mutable mutex lock;                     // guards the shard list only
+    vector<unique_ptr<MetricsShard>> shards;   // kept when their thread exits
+
+    template <int N>
+    static void sumInto(const Histogram<N>& from, uint64_t* buckets, uint64_t& count, double& sum) {
+        for (int b = 0; b <= N; b++) buckets[b] += from.buckets[b].load(memory_order_relaxed);
+        count += from.count.load(memory_order_relaxed);
+        sum += from.sum.load(memory_order_relaxed);
+    }
+
+    static void writeHeader(ostringstream& out, const char* name, const char* type, const char* help) {
+        out << "# HELP " << name << ' ' << help << '\n';
+        out << "# TYPE " << name << ' ' << type << '\n';
+    }
+
+    // One histogram series; labels is the label list without braces
+    template <int N>
+    static void writeHistogram(ostringstream& out, const char* name, const string& labels, const double* bounds,
+                               const uint64_t* buckets, uint64_t count, double sum) {
+        uint64_t cumulative = 0;
+        for (int b = 0; b <= N; b++) {
+            cumulative += buckets[b];
+            out << name << "_bucket{" << labels << ",le=\"";
+            if (b < N) out << bounds[b];
+            else out << "+Inf";
+            out << "\"} " << cumulative << '\n';
+        }
+        out << name << "_sum{" << labels << "} " << sum << '\n';
+        out << name << "_count{" << labels << "} " << count << '\n';
+    }
+
+    // One series per engine of a per-search histogram such as settled
+    void writeSearchHistogram(ostringstream& out, const char* name, const char* help,
+                              Histogram<SEARCH_BUCKET_COUNT> (MetricsShard::*series)[ROUTE_ENGINE_COUNT]) const {
+        writeHeader(out, name, "histogram", help);
+        for (int e = 0; e < ROUTE_ENGINE_COUNT; e++) {
+            uint64_t buckets[SEARCH_BUCKET_COUNT + 1] = {0};
+            uint64_t count = 0;
+            double sum = 0;
+            for (const auto& shard : shards) sumInto((shard.get()->*series)[e], buckets, count, sum);
+            if (count == 0) continue;
+            string labels = string("engine=\"") + routeEngineName(static_cast<RouteEngine>(e)) + "\"";
+            writeHistogram<SEARCH_BUCKET_COUNT>(out, name, labels, SEARCH_BUCKETS, buckets, count, sum);
+        }
+    }
+
+public:
+    atomic<int> connectionsInFlight;
+    atomic<int> requestsInFlight;
+
+    Metrics() : connectionsInFlight(0), requestsInFlight(0) {}
+
+    // The calling thread's shard, registered on first use
+    MetricsShard& local() {
+        thread_local MetricsShard* shard = nullptr;
+        if (!shard) {
+            lock_guard<mutex> guard(lock);
+            shards.push_back(make_unique<MetricsShard>());
+            shard = shards.back().get();
+        }
+        return *shard;
+    }
+
+    // Nodes settled and heap pushes of one untraced route search
+    void observeSearch(RouteEngine engine, const RouteResult& result) {
+        MetricsShard& shard = local();
+        shard.settled[engine].observe(result.settled, SEARCH_BUCKETS);
+        shard.pushes[engine].observe(result.pushes, SEARCH_BUCKETS);
+    }
+
+    // Everything recorded so far, in Prometheus text exposition format
+    string render() const {
+        lock_guard<mutex> guard(lock);
+        ostringstream out;
+        out << setprecision(10);   // bucket bounds as 1000000, not 1e+06
+
+        uint64_t requests[METRIC_ROUTE_COUNT] = {0};
+        uint64_t errors[METRIC_ROUTE_COUNT] = {0};
+        for (const auto& shard : shards) {
+            for (int r = 0; r < METRIC_ROUTE_COUNT; r++) {
+                requests[r] += shard->requests[r].load(memory_order_relaxed);
+                errors[r] += shard->errors[r].load(memory_order_relaxed);
+            }
+        }
+
+        writeHeader(out, "campus_requests_total", "counter", "Requests handled, by endpoint");
+        for (int r = 0; r < METRIC_ROUTE_COUNT; r++) {
+            if (requests[r] > 0) out << "campus_requests_total{route=\"" << METRIC_ROUTES[r] << "\"} " << requests[r] << '\n';
+        }
+        writeHeader(out, "campus_request_errors_total", "counter", "Requests answered with an error, by endpoint");
+        for (int r = 0; r < METRIC_ROUTE_COUNT; r++) {
+            if (requests[r] > 0) out << "campus_request_errors_total{route=\"" << METRIC_ROUTES[r] << "\"} " << errors[r] << '\n';
+        }
+
+        writeHeader(out, "campus_request_duration_seconds", "histogram", "Request latency by endpoint and phase");
+        for (int r = 0; r < METRIC_ROUTE_COUNT; r++) {
+            if (requests[r] == 0) continue;
+            for (int p = 0; p < PHASE_COUNT; p++) {
+                uint64_t buckets[LATENCY_BUCKET_COUNT + 1] = {0};
+                uint64_t count = 0;
+                double sum = 0;
+                for (const auto& shard : shards) sumInto(shard->latency[r][p], buckets, count, sum);
+                if (count == 0) continue;
+                string labels = string("route=\"") + METRIC_ROUTES[r] + "\",phase=\"" + PHASE_NAMES[p] + "\"";
+                writeHistogram<LATENCY_BUCKET_COUNT>(out, "campus_request_duration_seconds", labels,
+                                                     LATENCY_BUCKETS, buckets, count, sum);
+            }
+        }
+
+        writeSearchHistogram(out, "campus_search_settled_nodes", "Nodes settled per untraced route search",
+                             &MetricsShard::settled);
+        writeSearchHistogram(out, "campus_search_heap_pushes", "Heap pushes per untraced route search",
+                             &MetricsShard::pushes);
+
+        writeHeader(out, "campus_connections_in_flight", "gauge", "Open client connections");
+        out << "campus_connections_in_flight " << connectionsInFlight.load() << '\n';
+        writeHeader(out, "campus_requests_in_flight", "gauge", "Requests being handled");
+        out << "campus_requests_in_flight " << requestsInFlight.load() << '\n';
+        return out.str();
+    }
+};
+
+// Append one unlabelled counter or gauge to rendered metrics
+void appendMetric(string& out, const char* name, const char* type, const char* help, double value) {
+    ostringstream line;
+    line << "# HELP " << name << ' ' << help << '\n';
+    line << "# TYPE " << name << ' ' << type << '\n';
+    line << name << ' ' << setprecision(12) << value << '\n';
+    out += line.str();
+}
+
+// Times the phases of one request and records them, with the request
+// count, when it goes out of scope
+class RequestTimer {
+private:
+    Metrics& metrics;
+    int route;
+    chrono::steady_clock::time_point last;
+    double phases[PHASE_COUNT];
+    bool seen[PHASE_COUNT];
+    bool failed;
+
+public:
+    // parseSeconds: time already spent parsing the HTTP request
+    RequestTimer(Metrics& metrics, const string& path, double parseSeconds)
+        : metrics(metrics), route(metricRoute(path)), last(chrono::steady_clock::now()), failed(false) {
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            phases[p] = 0;
+            seen[p] = false;
+        }
+        phases[PHASE_PARSE] = parseSeconds;
+        seen[PHASE_PARSE] = true;
+        metrics.requestsInFlight++;
+    }
+
+    RequestTimer(const RequestTimer&) = delete;
+    RequestTimer& operator=(const RequestTimer&) = delete;
+
+    // Charge the time since the previous mark to phase
+    void mark(RequestPhase phase) {
+        auto now = chrono::steady_clock::now();
+        phases[phase] += chrono::duration<double>(now - last).count();
+        seen[phase] = true;
+        last = now;
+    }
+
+    void fail() {
+        failed = true;
+    }
+
+    ~RequestTimer() {
+        MetricsShard& shard = metrics.local();
+        bump(shard.requests[route]);
+        if (failed) bump(shard.errors[route]);
+        double total = 0;
+        for (int p = 0; p < PHASE_TOTAL; p++) {
+            if (!seen[p]) continue;
+            shard.latency[route][p].observe(phases[p], LATENCY_BUCKETS);
+            total += phases[p];
+        }
+        shard.latency[route][PHASE_TOTAL].observe(total, LATENCY_BUCKETS);
+        metrics.requestsInFlight--;
+    }
+};
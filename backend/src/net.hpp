@@ -0,0 +1,218 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600   // WSAPoll
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#endif
+
+using namespace std;
+
+// Thin portable layer over BSD sockets and Winsock: non-blocking sockets,
+// gathered sends (writev / WSASend) and readiness waits. Everything else in
+// the server is written against these functions.
+
+#ifdef _WIN32
+typedef SOCKET socket_t;
+const socket_t NO_SOCKET = INVALID_SOCKET;
+#else
+typedef int socket_t;
+const socket_t NO_SOCKET = -1;
+#endif
+
+// A client that takes none of its queued response for this long is dropped
+const int SEND_TIMEOUT_MS = 30 * 1000;
+
+// receiveSome results besides a byte count
+const int NET_CLOSED = 0;
+const int NET_WOULD_BLOCK = -1;
+const int NET_ERROR = -2;
+
+// Call once before any other function here
+bool netStartup() {
+#ifdef _WIN32
+    WSADATA wsaData;
+    return WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+#else
+    signal(SIGPIPE, SIG_IGN);   // a client that went away is a failed send, not a signal
+    return true;
+#endif
+}
+
+void netCleanup() {
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+int lastNetError() {
+#ifdef _WIN32
+    return WSAGetLastError();
+#else
+    return errno;
+#endif
+}
+
+// True if the last call failed only because it would have blocked
+bool netWouldBlock() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+bool netInterrupted() {
+#ifdef _WIN32
+    return false;
+#else
+    return errno == EINTR;
+#endif
+}
+
+void closeSocket(socket_t s) {
+#ifdef _WIN32
+    closesocket(s);
+#else
+    close(s);
+#endif
+}
+
+bool setNonBlocking(socket_t s) {
+#ifdef _WIN32
+    u_long on = 1;
+    return ioctlsocket(s, FIONBIO, &on) == 0;
+#else
+    int flags = fcntl(s, F_GETFL, 0);
+    return flags != -1 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+// Non-blocking listening socket on every interface, NO_SOCKET on failure
+// with the reason in error
+socket_t openListener(int port, string& error) {
+    socket_t s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == NO_SOCKET) {
+        error = "Error creating socket: " + to_string(lastNetError());
+        return NO_SOCKET;
+    }
+
+    int opt = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);
+
+    if (::bind(s, (sockaddr*)&address, sizeof(address)) != 0) {
+        error = "Error binding socket: " + to_string(lastNetError());
+    } else if (listen(s, SOMAXCONN) != 0) {
+        error = "Error listening: " + to_string(lastNetError());
+    } else if (!setNonBlocking(s)) {
+        error = "Error making the socket non-blocking: " + to_string(lastNetError());
+    } else {
+        return s;
+    }
+    closeSocket(s);
+    return NO_SOCKET;
+}
+
+// Next pending connection as a non-blocking socket, NO_SOCKET if there is none
+socket_t acceptClient(socket_t listener) {
+    while (true) {
+        socket_t s = accept(listener, nullptr, nullptr);
+        if (s == NO_SOCKET) {
+            if (netInterrupted()) continue;
+            return NO_SOCKET;
+        }
+        if (setNonBlocking(s)) return s;
+        closeSocket(s);
+    }
+}
+
+// Bytes read into buffer, or NET_CLOSED, NET_WOULD_BLOCK or NET_ERROR
+int receiveSome(socket_t s, char* buffer, int size) {
+    while (true) {
+        int n = recv(s, buffer, size, 0);
+        if (n > 0) return n;
+        if (n == 0) return NET_CLOSED;
+        if (netInterrupted()) continue;
+        return netWouldBlock() ? NET_WOULD_BLOCK : NET_ERROR;
+    }
+}
+
+// Wait until s can take more data; false on timeout or error
+bool waitWritable(socket_t s, int timeoutMs) {
+#ifdef _WIN32
+    WSAPOLLFD entry = {s, POLLOUT, 0};
+    int n = WSAPoll(&entry, 1, timeoutMs);
+#else
+    pollfd entry = {s, POLLOUT, 0};
+    int n;
+    do {
+        n = poll(&entry, 1, timeoutMs);
+    } while (n < 0 && errno == EINTR);
+#endif
+    return n > 0 && (entry.revents & POLLOUT);
+}
+
+// One piece of a gathered send
+struct IoSlice {
+    const char* data;
+    size_t size;
+};
+
+// At most this many slices go to the kernel per call
+const int MAX_IO_SLICES = 16;
+
+// One gathered send of parts without blocking: the number of bytes the
+// socket took, NET_WOULD_BLOCK if it took none, or NET_ERROR
+long long sendSome(socket_t s, const IoSlice* parts, size_t count) {
+    int slices = 0;
+#ifdef _WIN32
+    WSABUF buffers[MAX_IO_SLICES];
+    for (size_t i = 0; i < count && slices < MAX_IO_SLICES; i++) {
+        if (parts[i].size == 0) continue;
+        buffers[slices].buf = const_cast<char*>(parts[i].data);
+        buffers[slices].len = static_cast<ULONG>(parts[i].size);
+        slices++;
+    }
+#else
+    iovec buffers[MAX_IO_SLICES];
+    for (size_t i = 0; i < count && slices < MAX_IO_SLICES; i++) {
+        if (parts[i].size == 0) continue;
+        buffers[slices].iov_base = const_cast<char*>(parts[i].data);
+        buffers[slices].iov_len = parts[i].size;
+        slices++;
+    }
+#endif
+    if (slices == 0) return 0;
+
+    while (true) {
+#ifdef _WIN32
+        DWORD sentBytes = 0;
+        if (WSASend(s, buffers, slices, &sentBytes, 0, nullptr, nullptr) == 0) return sentBytes;
+#else
+        long long sent = writev(s, buffers, slices);
+        if (sent >= 0) return sent;
+#endif
+        if (netInterrupted()) continue;
+        return netWouldBlock() ? NET_WOULD_BLOCK : NET_ERROR;
+    }
+}
@@ -0,0 +1,280 @@
+#pragma once
+#include "net.hpp"
+#include <vector>
+#include <unordered_map>
+#include <stdexcept>
+
+// Readiness backend: epoll on Linux, kqueue on macOS and the BSDs, poll
+// (WSAPoll on Windows) elsewhere. Build with -DPOLLER_USE_POLL to force the
+// portable one.
+#if !defined(POLLER_USE_POLL)
+#if defined(__linux__)
+#define POLLER_EPOLL 1
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__DragonFly__)
+#define POLLER_KQUEUE 1
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#endif
+#endif
+
+using namespace std;
+
+// Waits for sockets to become readable, or writable for those armed with
+// rearmWritable(). Every watched socket is one-shot: once wait() has
+// reported it, it stays quiet until rearmed, so a socket handed to a worker
+// is never reported twice. Only the event loop thread
+// may call the methods, except wake(), which any thread may call to make a
+// pending wait() return early.
+class Poller {
+private:
+#if defined(POLLER_EPOLL)
+    int epollFd;
+    int wakeFd;   // eventfd
+    vector<epoll_event> events;
+
+    bool control(int op, socket_t s, uint32_t interest = EPOLLIN) {
+        epoll_event event = {};
+        event.events = interest | EPOLLONESHOT;
+        event.data.fd = s;
+        return epoll_ctl(epollFd, op, s, &event) == 0;
+    }
+#elif defined(POLLER_KQUEUE)
+    int queueFd;
+    vector<struct kevent> events;
+    static const uintptr_t WAKE_IDENT = 0;
+
+    bool control(socket_t s, unsigned short flags, short filter = EVFILT_READ) {
+        struct kevent change;
+        EV_SET(&change, s, filter, flags, 0, 0, nullptr);
+        return kevent(queueFd, &change, 1, nullptr, 0, nullptr) == 0;
+    }
+#else
+#ifdef _WIN32
+    typedef WSAPOLLFD PollEntry;
+#else
+    typedef pollfd PollEntry;
+#endif
+    vector<PollEntry> entries;              // armed sockets; entries[0] is the wake socket
+    unordered_map<socket_t, size_t> slots;  // armed socket -> index in entries
+    socket_t wakeRead, wakeWrite;           // pipe, or a loopback TCP pair on Windows
+
+    void arm(socket_t s, short interest = POLLIN) {
+        auto it = slots.find(s);
+        if (it != slots.end()) {
+            entries[it->second].events = interest;
+            return;
+        }
+        slots[s] = entries.size();
+        entries.push_back({s, interest, 0});
+    }
+
+    void disarm(socket_t s) {
+        auto it = slots.find(s);
+        if (it == slots.end()) return;
+        size_t i = it->second;
+        slots.erase(it);
+        if (i + 1 != entries.size()) {
+            entries[i] = entries.back();
+            slots[entries[i].fd] = i;
+        }
+        entries.pop_back();
+    }
+
+    void openWakeChannel() {
+#ifdef _WIN32
+        // Windows has no pipe WSAPoll can wait on: connect a socket to itself
+        socket_t listener = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+        int length = sizeof(address);
+        wakeRead = wakeWrite = NO_SOCKET;
+        if (listener != NO_SOCKET &&
+            ::bind(listener, (sockaddr*)&address, sizeof(address)) == 0 && listen(listener, 1) == 0 &&
+            getsockname(listener, (sockaddr*)&address, &length) == 0) {
+            wakeWrite = socket(AF_INET, SOCK_STREAM, 0);
+            if (wakeWrite != NO_SOCKET && connect(wakeWrite, (sockaddr*)&address, sizeof(address)) == 0) {
+                wakeRead = accept(listener, nullptr, nullptr);
+            }
+        }
+        if (listener != NO_SOCKET) closeSocket(listener);
+        if (wakeRead == NO_SOCKET) throw runtime_error("Cannot create the event loop wake socket");
+        setNonBlocking(wakeRead);
+        setNonBlocking(wakeWrite);
+#else
+        int fds[2];
+        if (pipe(fds) != 0) throw runtime_error("Cannot create the event loop wake pipe");
+        wakeRead = fds[0];
+        wakeWrite = fds[1];
+        fcntl(wakeRead, F_SETFL, fcntl(wakeRead, F_GETFL, 0) | O_NONBLOCK);
+        fcntl(wakeWrite, F_SETFL, fcntl(wakeWrite, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    }
+
+    void drainWakeChannel() {
+        char buffer[256];
+#ifdef _WIN32
+        while (recv(wakeRead, buffer, sizeof(buffer), 0) > 0) {}
+#else
+        while (read(wakeRead, buffer, sizeof(buffer)) > 0) {}
+#endif
+    }
+#endif
+
+public:
+    Poller() {
+#if defined(POLLER_EPOLL)
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epollFd < 0 || wakeFd < 0) throw runtime_error("Cannot create the epoll event loop");
+        epoll_event event = {};
+        event.events = EPOLLIN;   // level-triggered, never one-shot
+        event.data.fd = wakeFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+        events.resize(256);
+#elif defined(POLLER_KQUEUE)
+        queueFd = kqueue();
+        if (queueFd < 0) throw runtime_error("Cannot create the kqueue event loop");
+        struct kevent change;
+        EV_SET(&change, WAKE_IDENT, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+        kevent(queueFd, &change, 1, nullptr, 0, nullptr);
+        events.resize(256);
+#else
+        openWakeChannel();
+        entries.push_back({wakeRead, POLLIN, 0});
+#endif
+    }
+
+    ~Poller() {
+#if defined(POLLER_EPOLL)
+        close(epollFd);
+        close(wakeFd);
+#elif defined(POLLER_KQUEUE)
+        close(queueFd);
+#else
+        closeSocket(wakeRead);
+        closeSocket(wakeWrite);
+#endif
+    }
+
+    Poller(const Poller&) = delete;
+    Poller& operator=(const Poller&) = delete;
+
+    static const char* name() {
+#if defined(POLLER_EPOLL)
+        return "epoll";
+#elif defined(POLLER_KQUEUE)
+        return "kqueue";
+#elif defined(_WIN32)
+        return "WSAPoll";
+#else
+        return "poll";
+#endif
+    }
+
+    // Start watching s, armed
+    bool watch(socket_t s) {
+#if defined(POLLER_EPOLL)
+        return control(EPOLL_CTL_ADD, s);
+#elif defined(POLLER_KQUEUE)
+        return control(s, EV_ADD | EV_DISPATCH);
+#else
+        arm(s);
+        return true;
+#endif
+    }
+
+    // Report s again once it is readable
+    void rearm(socket_t s) {
+#if defined(POLLER_EPOLL)
+        control(EPOLL_CTL_MOD, s);
+#elif defined(POLLER_KQUEUE)
+        control(s, EV_ENABLE | EV_DISPATCH);
+#else
+        arm(s);
+#endif
+    }
+
+    // Report s once it can take more data (or has failed), instead of when
+    // it is readable
+    void rearmWritable(socket_t s) {
+#if defined(POLLER_EPOLL)
+        control(EPOLL_CTL_MOD, s, EPOLLOUT);
+#elif defined(POLLER_KQUEUE)
+        control(s, EV_ADD | EV_ONESHOT, EVFILT_WRITE);
+#else
+        arm(s, POLLOUT);
+#endif
+    }
+
+    // Stop watching s; call before closing it
+    void forget(socket_t s) {
+#if defined(POLLER_EPOLL)
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, s, nullptr);
+#elif defined(POLLER_KQUEUE)
+        control(s, EV_DELETE);
+        control(s, EV_DELETE, EVFILT_WRITE);   // fails harmlessly if not armed
+#else
+        disarm(s);
+#endif
+    }
+
+    // Wait up to timeoutMs for ready sockets and put them in ready,
+    // which may come back empty after a timeout or wake()
+    void wait(vector<socket_t>& ready, int timeoutMs) {
+        ready.clear();
+#if defined(POLLER_EPOLL)
+        int n = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), timeoutMs);
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == wakeFd) {
+                uint64_t count;
+                while (read(wakeFd, &count, sizeof(count)) > 0) {}
+            } else {
+                ready.push_back(events[i].data.fd);
+            }
+        }
+#elif defined(POLLER_KQUEUE)
+        timespec timeout = {timeoutMs / 1000, (timeoutMs % 1000) * 1000000L};
+        int n = kevent(queueFd, nullptr, 0, events.data(), static_cast<int>(events.size()), &timeout);
+        for (int i = 0; i < n; i++) {
+            if (events[i].filter == EVFILT_READ || events[i].filter == EVFILT_WRITE) {
+                ready.push_back(static_cast<socket_t>(events[i].ident));
+            }
+        }
+#else
+#ifdef _WIN32
+        int n = WSAPoll(entries.data(), static_cast<ULONG>(entries.size()), timeoutMs);
+#else
+        int n = poll(entries.data(), entries.size(), timeoutMs);
+#endif
+        if (n <= 0) return;
+        if (entries[0].revents) drainWakeChannel();
+        for (size_t i = 1; i < entries.size(); i++) {
+            if (entries[i].revents) ready.push_back(entries[i].fd);
+        }
+        for (socket_t s : ready) disarm(s);   // one-shot
+#endif
+    }
+
+    // Make wait() return now; safe from any thread
+    void wake() {
+#if defined(POLLER_EPOLL)
+        uint64_t one = 1;
+        ssize_t written = write(wakeFd, &one, sizeof(one));
+        (void)written;
+#elif defined(POLLER_KQUEUE)
+        struct kevent change;
+        EV_SET(&change, WAKE_IDENT, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+        kevent(queueFd, &change, 1, nullptr, 0, nullptr);
+#elif defined(_WIN32)
+        send(wakeWrite, "!", 1, 0);
+#else
+        ssize_t written = write(wakeWrite, "!", 1);
+        (void)written;
+#endif
+    }
+};
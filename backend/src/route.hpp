@@ -0,0 +1,299 @@
+#pragma once
+#include "graph.hpp"
+#include "indexed_heap.hpp"
+#include "search_workspace.hpp"
+#include "../lib/json.hpp"
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+using json = nlohmann::json;
+using namespace std;
+
+// Result of a route query, without any visualization trace
+struct RouteResult {
+    int start;
+    int end;
+    int distance;       // -1 if end is unreachable
+    vector<int> path;   // start..end, empty if unreachable
+    int settled;        // nodes removed from the queue and finalized
+    int pushes;         // heap insertions and decrease-keys, for the metrics
+
+    RouteResult() : start(-1), end(-1), distance(-1), settled(0), pushes(0) {}
+
+    // Compact response for clients that only need the route
+    json toJSON(const string& algorithm) const {
+        json j;
+        j["algorithm"] = algorithm;
+        j["start"] = start;
+        j["end"] = end;
+        j["distance"] = distance;
+        j["path"] = path;
+        j["settled"] = settled;
+        return j;
+    }
+};
+
+// Search engines available on the routing endpoints
+enum RouteEngine {
+    ENGINE_DIJKSTRA,
+    ENGINE_ASTAR,
+    ENGINE_BIDIRECTIONAL
+};
+
+// Parse the "algorithm" query parameter, defaulting to Dijkstra
+RouteEngine parseRouteEngine(const string& value) {
+    if (value.empty() || value == "dijkstra") return ENGINE_DIJKSTRA;
+    if (value == "astar") return ENGINE_ASTAR;
+    if (value == "bidirectional") return ENGINE_BIDIRECTIONAL;
+    throw invalid_argument("Unknown algorithm: " + value);
+}
+
+const char* routeEngineName(RouteEngine engine) {
+    switch (engine) {
+        case ENGINE_ASTAR: return "astar";
+        case ENGINE_BIDIRECTIONAL: return "bidirectional";
+        default: return "dijkstra";
+    }
+}
+
+// A request the server cannot answer right now, such as algorithm=table
+// while the distance table is not built; answered with 503
+struct Unavailable : runtime_error {
+    using runtime_error::runtime_error;
+};
+
+// Throw if a node id does not exist in the graph
+void checkNodeId(const Graph& g, int id) {
+    if (id < 0 || id >= g.size()) {
+        throw out_of_range("Invalid node id: " + to_string(id));
+    }
+}
+
+// Walk the previous[] chain back from end
+vector<int> buildPath(const vector<int>& previous, int start, int end) {
+    vector<int> path;
+    for (int v = end; v != -1; v = previous[v]) {
+        path.push_back(v);
+        if (v == start) break;
+    }
+    reverse(path.begin(), path.end());
+    return path;
+}
+
+// Plain Dijkstra with early exit at end, no step recording
+RouteResult shortestRoute(const Graph& graph, int start, int end) {
+    checkNodeId(graph, start);
+    checkNodeId(graph, end);
+
+    SearchWorkspace& ws = threadWorkspace();
+    ws.begin(graph.size());
+    IndexedHeap& pq = ws.heap;
+    int settled = 0;
+
+    ws.reach(start, 0, -1);
+    pq.push(start, 0);
+
+    while (!pq.empty()) {
+        int u = pq.pop().second;
+        ws.settle(u);
+        settled++;
+        if (u == end) break;
+
+        int distU = ws.distance(u);
+        for (const auto& adj : graph.neighbors(u)) {
+            int newDist = distU + adj.weight;
+            if (!ws.settled(adj.to) && newDist < ws.distance(adj.to)) {
+                ws.reach(adj.to, newDist, u);
+                pq.push(adj.to, newDist);
+            }
+        }
+    }
+
+    RouteResult result;
+    result.start = start;
+    result.end = end;
+    result.settled = settled;
+    result.pushes = static_cast<int>(pq.pushCount());
+    if (ws.distance(end) != INF) {
+        result.distance = ws.distance(end);
+        result.path = ws.path(start, end);
+    }
+    return result;
+}
+
+// One Dijkstra tree from start answering several ends, stopping once all of
+// them are settled. Results follow the order of ends; settled counts the
+// whole shared search.
+vector<RouteResult> routesFromSource(const Graph& graph, int start, const vector<int>& ends) {
+    checkNodeId(graph, start);
+    for (int end : ends) checkNodeId(graph, end);
+
+    // Distinct ends, looked up by binary search as nodes are settled
+    vector<int> wanted(ends);
+    sort(wanted.begin(), wanted.end());
+    wanted.erase(unique(wanted.begin(), wanted.end()), wanted.end());
+    size_t remaining = wanted.size();
+    int settled = 0;
+
+    SearchWorkspace& ws = threadWorkspace();
+    ws.begin(graph.size());
+    IndexedHeap& pq = ws.heap;
+    ws.reach(start, 0, -1);
+    pq.push(start, 0);
+
+    while (!pq.empty() && remaining > 0) {
+        int u = pq.pop().second;
+        ws.settle(u);
+        settled++;
+        if (binary_search(wanted.begin(), wanted.end(), u)) remaining--;
+
+        int distU = ws.distance(u);
+        for (const auto& adj : graph.neighbors(u)) {
+            int newDist = distU + adj.weight;
+            if (!ws.settled(adj.to) && newDist < ws.distance(adj.to)) {
+                ws.reach(adj.to, newDist, u);
+                pq.push(adj.to, newDist);
+            }
+        }
+    }
+
+    vector<RouteResult> results(ends.size());
+    for (size_t i = 0; i < ends.size(); i++) {
+        RouteResult& result = results[i];
+        result.start = start;
+        result.end = ends[i];
+        result.settled = settled;
+        result.pushes = static_cast<int>(pq.pushCount());
+        if (ws.distance(ends[i]) != INF) {
+            result.distance = ws.distance(ends[i]);
+            result.path = ws.path(start, ends[i]);
+        }
+    }
+    return results;
+}
+
+// A* ordered by dist + straight-line lower bound to end, no step recording.
+// The bound is consistent, so a node's distance is final once it is settled.
+RouteResult astarRoute(const Graph& graph, int start, int end) {
+    checkNodeId(graph, start);
+    checkNodeId(graph, end);
+
+    SearchWorkspace& ws = threadWorkspace();
+    ws.begin(graph.size());
+    IndexedHeap& pq = ws.heap;   // keyed by dist + estimate
+    int settled = 0;
+
+    ws.reach(start, 0, -1);
+    pq.push(start, graph.distanceLowerBound(start, end));
+
+    while (!pq.empty()) {
+        int u = pq.pop().second;
+        ws.settle(u);
+        settled++;
+        if (u == end) break;
+
+        int distU = ws.distance(u);
+        for (const auto& adj : graph.neighbors(u)) {
+            int newDist = distU + adj.weight;
+            if (!ws.settled(adj.to) && newDist < ws.distance(adj.to)) {
+                ws.reach(adj.to, newDist, u);
+                pq.push(adj.to, newDist + graph.distanceLowerBound(adj.to, end));
+            }
+        }
+    }
+
+    RouteResult result;
+    result.start = start;
+    result.end = end;
+    result.settled = settled;
+    result.pushes = static_cast<int>(pq.pushCount());
+    if (ws.distance(end) != INF) {
+        result.distance = ws.distance(end);
+        result.path = ws.path(start, end);
+    }
+    return result;
+}
+
+// Dijkstra grown from both ends at once, expanding whichever frontier is
+// closer. Exact because addEdge makes every edge usable in both directions.
+// Stops once the two frontier radii add up to the best meeting distance.
+RouteResult bidirectionalRoute(const Graph& graph, int start, int end) {
+    checkNodeId(graph, start);
+    checkNodeId(graph, end);
+
+    RouteResult result;
+    result.start = start;
+    result.end = end;
+    if (start == end) {
+        result.distance = 0;
+        result.path = {start};
+        result.settled = 1;
+        return result;
+    }
+
+    // Workspace 0 searches from start, workspace 1 from end
+    SearchWorkspace* ws[2] = {&threadWorkspace(0), &threadWorkspace(1)};
+    ws[0]->begin(graph.size());
+    ws[1]->begin(graph.size());
+    int settled = 0;
+
+    ws[0]->reach(start, 0, -1);
+    ws[1]->reach(end, 0, -1);
+    ws[0]->heap.push(start, 0);
+    ws[1]->heap.push(end, 0);
+
+    int best = INF;
+    int meet[2] = {-1, -1};   // best connecting edge: meet[0] on the start side, meet[1] on the end side
+
+    while (!ws[0]->heap.empty() && !ws[1]->heap.empty()) {
+        if ((long long)ws[0]->heap.top().first + ws[1]->heap.top().first >= best) break;
+
+        int side = (ws[0]->heap.top().first <= ws[1]->heap.top().first) ? 0 : 1;
+        SearchWorkspace& here = *ws[side];
+        SearchWorkspace& there = *ws[1 - side];
+
+        int u = here.heap.pop().second;
+        here.settle(u);
+        settled++;
+
+        int distU = here.distance(u);
+        for (const auto& adj : graph.neighbors(u)) {
+            int v = adj.to;
+            int newDist = distU + adj.weight;
+            if (!here.settled(v) && newDist < here.distance(v)) {
+                here.reach(v, newDist, u);
+                here.heap.push(v, newDist);
+            }
+            if (there.distance(v) != INF && newDist + there.distance(v) < best) {
+                best = newDist + there.distance(v);
+                meet[side] = u;
+                meet[1 - side] = v;
+            }
+        }
+    }
+
+    result.settled = settled;
+    result.pushes = static_cast<int>(ws[0]->heap.pushCount() + ws[1]->heap.pushCount());
+    if (best != INF) {
+        result.distance = best;
+        result.path = ws[0]->path(start, meet[0]);
+        for (int v = meet[1]; v != -1; v = ws[1]->predecessor(v)) {
+            result.path.push_back(v);
+        }
+    }
+    return result;
+}
+
+RouteResult findRoute(const Graph& g, int start, int end, RouteEngine engine) {
+    switch (engine) {
+        case ENGINE_ASTAR: return astarRoute(g, start, end);
+        case ENGINE_BIDIRECTIONAL: return bidirectionalRoute(g, start, end);
+        default: return shortestRoute(g, start, end);
+    }
+}
+
+// Main API function for the fast (trace-free) route
+json getShortestRoute(const Graph& g, int start, int end, RouteEngine engine = ENGINE_DIJKSTRA) {
+    return findRoute(g, start, end, engine).toJSON(routeEngineName(engine));
+}
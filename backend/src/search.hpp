@@ -7,21 +7,47 @@
 using json = nlohmann::json;
 using namespace std;
 
+// What a binary search step did. Clients render the text from the code,
+// the step's indexes, the query and the sorted array.
+enum SearchStepCode {
+    SEARCH_START,       // searching the whole array
+    SEARCH_CHECK,       // comparing the query with the middle element
+    SEARCH_FOUND,       // the middle element matches
+    SEARCH_LEFT,        // query sorts before the middle element
+    SEARCH_RIGHT,       // query sorts after it
+    SEARCH_NOT_FOUND    // range empty
+};
+
+const char* searchStepCodeName(SearchStepCode code) {
+    switch (code) {
+        case SEARCH_START: return "start";
+        case SEARCH_CHECK: return "check";
+        case SEARCH_FOUND: return "found";
+        case SEARCH_LEFT: return "left";
+        case SEARCH_RIGHT: return "right";
+        default: return "notfound";
+    }
+}
+
 // Structure to store information about each step of the binary search
 struct SearchStep {
     int stepNum;
-    string action;
+    SearchStepCode code;
+    string action;          // Only with server-side text
     string explanation;
     int left, right, mid;
     int compareNode;
     bool found;
     
     // Convert this step to JSON format for the response
-    json toJSON(const Graph& g) const {
+    json toJSON() const {
         json stepJson;
         stepJson["step"] = stepNum;
-        stepJson["action"] = action;
-        stepJson["explanation"] = explanation;
+        stepJson["code"] = searchStepCodeName(code);
+        if (!action.empty()) {
+            stepJson["action"] = action;
+            stepJson["explanation"] = explanation;
+        }
         stepJson["left"] = left;
         stepJson["right"] = right;
         stepJson["mid"] = mid;
@@ -35,80 +61,100 @@ class BinarySearchVisualizer {
 private:
     vector<SearchStep> steps;  // Store all search steps for visualization
     int stepNum;  // Track current step number
+    bool withText;  // Render action/explanation text into each step
+    const Graph* searched;  // Graph of the running search
+    string query;
+    
+    // English text for a step, only built when asked for
+    void describe(SearchStep& step) const {
+        string midName = step.mid >= 0 ? string(searched->getName(searched->getNameOrder()[step.mid])) : "";
+        switch (step.code) {
+            case SEARCH_START:
+                step.action = "Starting binary search";
+                step.explanation = "Array is sorted alphabetically. Searching for: " + query;
+                break;
+            case SEARCH_CHECK:
+                step.action = "Checking middle element";
+                step.explanation = "Range: [" + to_string(step.left) + ", " + to_string(step.right) +
+                                   "]. Midpoint: " + to_string(step.mid) + " (" + midName + ")";
+                break;
+            case SEARCH_FOUND:
+                step.action = "Found!";
+                step.explanation = "'" + query + "' matches '" + midName + "' at index " + to_string(step.mid);
+                break;
+            case SEARCH_LEFT:
+                step.action = "Search left half";
+                step.explanation = "'" + query + "' < '" + midName + "'. Discard right half and search left.";
+                break;
+            case SEARCH_RIGHT:
+                step.action = "Search right half";
+                step.explanation = "'" + query + "' > '" + midName + "'. Discard left half and search right.";
+                break;
+            case SEARCH_NOT_FOUND:
+                step.action = "Not found";
+                step.explanation = "Search completed. '" + query + "' not found in the campus.";
+                break;
+        }
+    }
     
-    void recordStep(const string& action, const string& explanation, 
-                   int left, int right, int mid, int compareNode, bool found) { // Record each step of the binary search process
+    void recordStep(SearchStepCode code, int left, int right, int mid, int compareNode, bool found) { // Record each step of the binary search process
         SearchStep currentStep;
         currentStep.stepNum = stepNum++;
-        currentStep.action = action;
-        currentStep.explanation = explanation;
+        currentStep.code = code;
         currentStep.left = left;
         currentStep.right = right;
         currentStep.mid = mid;
         currentStep.compareNode = compareNode;
         currentStep.found = found;
-        steps.push_back(currentStep);
+        if (withText) describe(currentStep);
+        steps.push_back(move(currentStep));
     }
     
 public:
-    BinarySearchVisualizer() : stepNum(0) {}
+    explicit BinarySearchVisualizer(bool withText = false) : stepNum(0), withText(withText), searched(nullptr) {}
     
-    json search(const Graph& graph, const string& searchQuery) {         // Get all nodes from the graph and sort them alphabetically
-        vector<Node> sortedNodes = graph.getNodes();
-        sort(sortedNodes.begin(), sortedNodes.end(), 
-             [](const Node& a, const Node& b) { return a.name < b.name; });
+    json search(const Graph& graph, const string& searchQuery) {         // Use the graph's name index: node ids sorted alphabetically, built once at load
+        searched = &graph;
+        query = searchQuery;
+        const vector<int>& sortedIds = graph.getNameOrder();
+        auto nodeAt = [&](int index) { return graph.getNode(sortedIds[index]); };
         
         int left = 0;         // Initialize search range: left is start, right is end
-        int right = sortedNodes.size() - 1;
+        int right = sortedIds.size() - 1;
         int foundIndex = -1;  // Will store the index if found, -1 means not found
         
-        recordStep("Starting binary search",          // Record the initial state
-                  "Array is sorted alphabetically. Searching for: " + searchQuery,
-                  left, right, -1, -1, false);
+        recordStep(SEARCH_START, left, right, -1, -1, false);          // Record the initial state
         
         while (left <= right) {  // Binary search main loop - continues while search range is valid
 
             int mid = left + (right - left) / 2;             // Calculate middle index (avoids overflow compared to (left + right) / 2)
 
             
-            recordStep("Checking middle element",
-                      "Range: [" + to_string(left) + ", " + to_string(right) + 
-                      "]. Midpoint: " + to_string(mid) + " (" + sortedNodes[mid].name + ")",
-                      left, right, mid, mid, false);
+            recordStep(SEARCH_CHECK, left, right, mid, mid, false);
             
-            int comparison = searchQuery.compare(sortedNodes[mid].name);             // Compare search query with middle element
+            int comparison = searchQuery.compare(nodeAt(mid).name);             // Compare search query with middle element
             
             if (comparison == 0) {              // Returns: 0 if equal, <0 if query comes before, >0 if query comes after
 
                 foundIndex = mid;
-                recordStep("Found!",
-                          "'" + searchQuery + "' matches '" + sortedNodes[mid].name + "' at index " + to_string(mid),
-                          left, right, mid, mid, true);
+                recordStep(SEARCH_FOUND, left, right, mid, mid, true);
                 break;
             } 
             else if (comparison < 0) {                 // Search query comes before middle element alphabetically
 
-                recordStep("Search left half",          // Discard right half, search in left half
-                          "'" + searchQuery + "' < '" + sortedNodes[mid].name + "'. "
-                          "Discard right half and search left.",
-                          left, mid - 1, mid, mid, false);
+                recordStep(SEARCH_LEFT, left, mid - 1, mid, mid, false);          // Discard right half, search in left half
                 right = mid - 1;
             } 
             else {
 
-                recordStep("Search right half",           // Discard left half, search in right half
-                          "'" + searchQuery + "' > '" + sortedNodes[mid].name + "'. "
-                          "Discard left half and search right.",
-                          mid + 1, right, mid, mid, false);
+                recordStep(SEARCH_RIGHT, mid + 1, right, mid, mid, false);           // Discard left half, search in right half
                 left = mid + 1;
             }
         }
         
 
         if (foundIndex == -1) {           // If we exit the loop without finding, record that
-            recordStep("Not found",
-                      "Search completed. '" + searchQuery + "' not found in the campus.",
-                      left, right, -1, -1, false);
+            recordStep(SEARCH_NOT_FOUND, left, right, -1, -1, false);
         }
         
         json result;          // Build JSON response with all search information
@@ -117,17 +163,19 @@ public:
         result["found"] = (foundIndex != -1);
         
         if (foundIndex != -1) {
+            Node found = nodeAt(foundIndex);
             result["result"] = {
-                {"id", sortedNodes[foundIndex].id},
-                {"name", sortedNodes[foundIndex].name},
-                {"type", sortedNodes[foundIndex].type},
-                {"x", sortedNodes[foundIndex].x},
-                {"y", sortedNodes[foundIndex].y}
+                {"id", found.id},
+                {"name", found.name},
+                {"type", found.type},
+                {"x", found.x},
+                {"y", found.y}
             };
         }
         
         result["sortedArray"] = json::array();          // Include the sorted array used for searching
-        for (const auto& node : sortedNodes) {
+        for (int id : sortedIds) {
+            Node node = graph.getNode(id);
             result["sortedArray"].push_back({
                 {"id", node.id},
                 {"name", node.name}
@@ -136,7 +184,7 @@ public:
         
         result["steps"] = json::array();          // Include all recorded steps for visualization
         for (const auto& step : steps) {
-            result["steps"].push_back(step.toJSON(graph));
+            result["steps"].push_back(step.toJSON());
         }
         
         result["complexity"] = {          // Include algorithm complexity information
@@ -149,7 +197,121 @@ public:
     }
 };
 
-json searchBuilding(const Graph& graph, const string& searchQuery) {   // Main function to search for a building in the graph
-    BinarySearchVisualizer visualizer;
+json searchBuilding(const Graph& graph, const string& searchQuery, bool withText = false) {   // Main function to search for a building in the graph
+    BinarySearchVisualizer visualizer(withText);
     return visualizer.search(graph, searchQuery);
-}
\ No newline at end of file
+}
+
+// How a suggestion matched the query, best first
+enum MatchKind {
+    MATCH_EXACT,
+    MATCH_PREFIX,
+    MATCH_WORD_PREFIX,   // query starts one of the later words of the name
+    MATCH_SUBSTRING,
+    MATCH_FUZZY          // within a small edit distance of a prefix of the name
+};
+
+const char* matchKindName(MatchKind kind) {
+    switch (kind) {
+        case MATCH_EXACT: return "exact";
+        case MATCH_PREFIX: return "prefix";
+        case MATCH_WORD_PREFIX: return "word";
+        case MATCH_SUBSTRING: return "substring";
+        default: return "fuzzy";
+    }
+}
+
+// Typos tolerated for a query of this length
+int maxEditsFor(size_t queryLength) {
+    if (queryLength < 3) return 0;
+    return (queryLength < 6) ? 1 : 2;
+}
+
+// Smallest edit distance between the query and any prefix of name,
+// or maxEdits + 1 once every alignment is already worse than maxEdits
+int prefixEditDistance(const string& query, const string& name, int maxEdits, vector<int>& row) {
+    // row[j] = edits to turn query[0..i) into name[0..j)
+    row.resize(name.size() + 1);
+    for (size_t j = 0; j <= name.size(); j++) row[j] = j;
+
+    for (size_t i = 1; i <= query.size(); i++) {
+        int diagonal = row[0];
+        row[0] = i;
+        int rowMin = row[0];
+        for (size_t j = 1; j <= name.size(); j++) {
+            int above = row[j];
+            int cost = (query[i - 1] == name[j - 1]) ? 0 : 1;
+            row[j] = min({above + 1, row[j - 1] + 1, diagonal + cost});
+            diagonal = above;
+            rowMin = min(rowMin, row[j]);
+        }
+        if (rowMin > maxEdits) return maxEdits + 1;
+    }
+    return *min_element(row.begin(), row.end());
+}
+
+// Typeahead suggestions: case-insensitive prefix matches come straight from
+// the graph's sorted index in O(log n + k); substring and fuzzy matches only
+// scan the names when the prefix range yields fewer than limit results.
+json suggestBuildings(const Graph& graph, const string& searchQuery, int limit) {
+    string query = foldCase(searchQuery);
+    const vector<pair<string, int>>& names = graph.getFoldedNames();
+
+    struct Match {
+        MatchKind kind;
+        int edits;
+        int id;
+    };
+    vector<Match> matches;
+    vector<bool> taken(graph.size(), false);
+
+    // Prefix range of the sorted lowercase names
+    auto it = lower_bound(names.begin(), names.end(), make_pair(query, -1));
+    for (; it != names.end() && (int)matches.size() < limit &&
+           it->first.compare(0, query.size(), query) == 0; ++it) {
+        matches.push_back({it->first.size() == query.size() ? MATCH_EXACT : MATCH_PREFIX, 0, it->second});
+        taken[it->second] = true;
+    }
+
+    if ((int)matches.size() < limit && !query.empty()) {
+        int maxEdits = maxEditsFor(query.size());
+        vector<int> row;
+        for (const auto& entry : names) {
+            if (taken[entry.second]) continue;
+            const string& name = entry.first;
+
+            size_t position = name.find(query);
+            if (position != string::npos) {
+                bool wordStart = position > 0 && name[position - 1] == ' ';
+                matches.push_back({wordStart ? MATCH_WORD_PREFIX : MATCH_SUBSTRING, 0, entry.second});
+            } else if (maxEdits > 0) {
+                int edits = prefixEditDistance(query, name, maxEdits, row);
+                if (edits <= maxEdits) {
+                    matches.push_back({MATCH_FUZZY, edits, entry.second});
+                }
+            }
+        }
+    }
+
+    // Best kind first, then fewer edits, then the name index order
+    stable_sort(matches.begin(), matches.end(), [](const Match& a, const Match& b) {
+        if (a.kind != b.kind) return a.kind < b.kind;
+        return a.edits < b.edits;
+    });
+    if ((int)matches.size() > limit) matches.resize(max(limit, 0));
+
+    json result;
+    result["query"] = searchQuery;
+    result["matches"] = json::array();
+    for (const auto& match : matches) {
+        Node node = graph.getNode(match.id);
+        result["matches"].push_back({
+            {"id", node.id},
+            {"name", node.name},
+            {"type", node.type},
+            {"match", matchKindName(match.kind)},
+            {"edits", match.edits}
+        });
+    }
+    return result;
+}
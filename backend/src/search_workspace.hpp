@@ -0,0 +1,88 @@
+#pragma once
+#include "graph.hpp"
+#include "indexed_heap.hpp"
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+using namespace std;
+
+// Scratch state of one single-source search, reused by every query on the
+// same thread. Each entry records the generation that wrote it and reads as
+// unset in any other, so starting a search is O(1) instead of refilling
+// n-sized dist/previous/visited arrays.
+class SearchWorkspace {
+private:
+    vector<int> dist;
+    vector<int> previous;
+    vector<uint32_t> reached;   // generation in which dist/previous were set
+    vector<uint32_t> done;      // generation in which the node was settled
+    uint32_t generation;
+
+public:
+    IndexedHeap heap;           // empty at the start of every search
+
+    SearchWorkspace() : generation(0) {}
+
+    // Start a search over a graph of n nodes
+    void begin(int n) {
+        if ((int)dist.size() != n) {
+            dist.assign(n, INF);
+            previous.assign(n, -1);
+            reached.assign(n, 0);
+            done.assign(n, 0);
+            heap = IndexedHeap(n);
+            generation = 0;
+        } else {
+            heap.clear();
+        }
+        if (++generation == 0) {
+            // Wrapped around: old stamps could look current again
+            fill(reached.begin(), reached.end(), 0);
+            fill(done.begin(), done.end(), 0);
+            generation = 1;
+        }
+    }
+
+    // Tentative distance, INF if not reached in this search
+    int distance(int v) const {
+        return reached[v] == generation ? dist[v] : INF;
+    }
+
+    // Predecessor on the best path found so far, -1 if none
+    int predecessor(int v) const {
+        return reached[v] == generation ? previous[v] : -1;
+    }
+
+    void reach(int v, int d, int from) {
+        dist[v] = d;
+        previous[v] = from;
+        reached[v] = generation;
+    }
+
+    bool settled(int v) const {
+        return done[v] == generation;
+    }
+
+    void settle(int v) {
+        done[v] = generation;
+    }
+
+    // Walk the predecessor chain back from end
+    vector<int> path(int start, int end) const {
+        vector<int> result;
+        for (int v = end; v != -1; v = predecessor(v)) {
+            result.push_back(v);
+            if (v == start) break;
+        }
+        reverse(result.begin(), result.end());
+        return result;
+    }
+};
+
+// The calling thread's workspaces; searches that run two at once (both
+// halves of a bidirectional search) use slots 0 and 1
+inline SearchWorkspace& threadWorkspace(int slot = 0) {
+    thread_local SearchWorkspace workspaces[2];
+    return workspaces[slot];
+}
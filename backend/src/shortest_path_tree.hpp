@@ -0,0 +1,137 @@
+#pragma once
+#include "graph.hpp"
+#include "indexed_heap.hpp"
+#include <vector>
+#include <memory>
+
+using namespace std;
+
+// A change to the edge between two nodes: weights as returned by
+// Graph::getWeight before and after, 0 meaning no edge
+struct EdgeChange {
+    int from, to;
+    int oldWeight, newWeight;
+};
+
+// Shortest-path tree over every node of a graph, or a forest when it is
+// grown from several sources: dist[v] is the distance from the nearest
+// root, INF if none is reachable, and parent[v] the next node towards it,
+// -1 at a root.
+struct ShortestPathTree {
+    vector<int> dist;
+    vector<int> parent;
+
+    explicit ShortestPathTree(int n = 0) : dist(n, INF), parent(n, -1) {}
+
+    size_t memoryBytes() const {
+        return (dist.capacity() + parent.capacity()) * sizeof(int);
+    }
+};
+
+// Continue Dijkstra in tree from the queued nodes, relaxing only improvements
+void propagateTree(const Graph& graph, ShortestPathTree& tree, IndexedHeap& pq) {
+    while (!pq.empty()) {
+        pair<int, int> top = pq.pop();
+        int d = top.first;
+        int u = top.second;
+
+        for (const auto& adj : graph.neighbors(u)) {
+            int newDist = d + adj.weight;
+            if (newDist < tree.dist[adj.to]) {
+                tree.dist[adj.to] = newDist;
+                tree.parent[adj.to] = u;
+                pq.push(adj.to, newDist);
+            }
+        }
+    }
+}
+
+// True if change can alter tree: a cheaper or new edge that brings one of
+// its ends closer, or a dearer or removed edge the tree uses
+bool treeAffected(const ShortestPathTree& tree, const EdgeChange& change) {
+    int a = change.from, b = change.to;
+    int oldWeight = change.oldWeight > 0 ? change.oldWeight : INF;
+    int newWeight = change.newWeight > 0 ? change.newWeight : INF;
+
+    if (newWeight < oldWeight) {
+        return (tree.dist[a] != INF && tree.dist[a] + newWeight < tree.dist[b]) ||
+               (tree.dist[b] != INF && tree.dist[b] + newWeight < tree.dist[a]);
+    }
+    return newWeight != oldWeight && (tree.parent[b] == a || tree.parent[a] == b);
+}
+
+// Repair tree after change; graph already has the new weight. Only nodes
+// whose distance can change are touched: after a decrease those that get
+// closer through the edge, after an increase the subtree that hung below
+// the edge. A child is always a neighbour of its parent, so the subtree is
+// walked through the adjacency lists and costs its own size, not the
+// graph's. subtree is scratch space.
+void repairTree(const Graph& graph, ShortestPathTree& tree, const EdgeChange& change, IndexedHeap& pq,
+                vector<int>& subtree) {
+    int a = change.from, b = change.to;
+    int oldWeight = change.oldWeight > 0 ? change.oldWeight : INF;
+    int newWeight = change.newWeight > 0 ? change.newWeight : INF;
+
+    if (newWeight < oldWeight) {
+        // Cheaper or new edge: seed whichever end it now brings closer
+        for (int k = 0; k < 2; k++) {
+            int x = k ? b : a, y = k ? a : b;
+            if (tree.dist[x] != INF && tree.dist[x] + newWeight < tree.dist[y]) {
+                tree.dist[y] = tree.dist[x] + newWeight;
+                tree.parent[y] = x;
+                pq.push(y, tree.dist[y]);
+            }
+        }
+        propagateTree(graph, tree, pq);
+        return;
+    }
+
+    // Dearer or removed edge: cut the subtree below it loose. Clearing each
+    // parent link as the child is taken keeps parallel edges from adding it twice.
+    int root = (tree.parent[b] == a) ? b : (tree.parent[a] == b) ? a : -1;
+    if (root == -1) return;
+    subtree.clear();
+    subtree.push_back(root);
+    tree.parent[root] = -1;
+    for (size_t i = 0; i < subtree.size(); i++) {
+        int u = subtree[i];
+        for (const auto& adj : graph.neighbors(u)) {
+            if (tree.parent[adj.to] == u) {
+                tree.parent[adj.to] = -1;
+                subtree.push_back(adj.to);
+            }
+        }
+    }
+    for (int v : subtree) tree.dist[v] = INF;
+
+    // Best way back in from the unaffected part of the tree, then settle
+    for (int v : subtree) {
+        for (const auto& adj : graph.neighbors(v)) {
+            int d = tree.dist[adj.to];
+            if (d != INF && d + adj.weight < tree.dist[v]) {
+                tree.dist[v] = d + adj.weight;
+                tree.parent[v] = adj.to;
+            }
+        }
+        if (tree.dist[v] != INF) pq.push(v, tree.dist[v]);
+    }
+    propagateTree(graph, tree, pq);
+}
+
+// Bring every tree in trees up to date with one edge change. Trees are
+// shared between graph versions and never changed in place: each affected
+// one is copied and the copy repaired, so the cost follows the change and
+// not the number of trees kept. Returns the number of trees repaired.
+int repairTrees(const Graph& graph, vector<shared_ptr<const ShortestPathTree>>& trees, const EdgeChange& change) {
+    IndexedHeap pq(graph.size());
+    vector<int> subtree;
+    int repaired = 0;
+    for (auto& tree : trees) {
+        if (!treeAffected(*tree, change)) continue;
+        auto copy = make_shared<ShortestPathTree>(*tree);
+        repairTree(graph, *copy, change, pq, subtree);
+        tree = move(copy);
+        repaired++;
+    }
+    return repaired;
+}
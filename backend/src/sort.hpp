@@ -1,32 +1,95 @@
 #pragma once
 #include "graph.hpp"
+#include "trace.hpp"
+#include "json_stream.hpp"
+#include "distance_sort.hpp"
+#include "arena.hpp"
 #include "../lib/json.hpp"
 #include <vector>
-#include <cmath>
+#include <stdexcept>
 
 using json = nlohmann::json;
 using namespace std;
 
-// Structure to store information about each step of the quicksort
+// What "distance" the locations are ranked by
+enum SortMetric {
+    METRIC_STRAIGHT_LINE,   // Euclidean distance between the coordinates
+    METRIC_NETWORK          // shortest walking distance over the graph
+};
+
+// Parse the "metric" query parameter; unknown values are rejected
+SortMetric parseSortMetric(const string& value) {
+    if (value.empty() || value == "euclidean") return METRIC_STRAIGHT_LINE;
+    if (value == "network") return METRIC_NETWORK;
+    throw invalid_argument("Unknown metric: " + value);
+}
+
+// What a quicksort step did. Clients render the text from the code, the
+// step's indexes and the array at that step.
+enum SortStepCode {
+    SORT_INIT,        // unsorted array
+    SORT_PARTITION,   // start partitioning low..high
+    SORT_PIVOT,       // array[pivot] chosen as pivot (median of three, moved to high)
+    SORT_COMPARE,     // array[right] compared with the pivot
+    SORT_SWAP,        // array[left] and array[right] swapped
+    SORT_PLACE,       // pivot placed at its final index pivot
+    SORT_DONE         // array sorted
+};
+
+const char* sortStepCodeName(SortStepCode code) {
+    switch (code) {
+        case SORT_INIT: return "init";
+        case SORT_PARTITION: return "partition";
+        case SORT_PIVOT: return "pivot";
+        case SORT_COMPARE: return "compare";
+        case SORT_SWAP: return "swap";
+        case SORT_PLACE: return "place";
+        default: return "sorted";
+    }
+}
+
+// Structure to store information about each step of the quicksort; its data
+// lives in the request arena and names point into the graph
 struct SortStep {
     int stepNum;
-    string action;
-    string explanation;
-    vector<int> array;
-    vector<string> names;
+    SortStepCode code;
+    ArenaString action;        // Only with server-side text
+    ArenaString explanation;
+    ArenaVector<int> array;
+    ArenaVector<string_view> names;
     int pivotIndex;
     int leftPointer;
     int rightPointer;
     int low, high;
     
+    // Delta traces only: keyframes keep array/names, other steps the swaps
+    bool isDelta;
+    bool keyframe;
+    ArenaVector<pair<int, int>> swaps;
+    
+    explicit SortStep(Arena& arena = requestArena())
+        : code(SORT_INIT), action(&arena), explanation(&arena), array(&arena), names(&arena),
+          isDelta(false), keyframe(false), swaps(&arena) {}
+    
     // Convert this step to JSON format
     json toJSON() const {
         json stepJson;
         stepJson["step"] = stepNum;
-        stepJson["action"] = action;
-        stepJson["explanation"] = explanation;
-        stepJson["array"] = array;
-        stepJson["names"] = names;
+        stepJson["code"] = sortStepCodeName(code);
+        if (!action.empty()) {
+            stepJson["action"] = action;
+            stepJson["explanation"] = explanation;
+        }
+        if (!isDelta || keyframe) {
+            stepJson["array"] = array;
+            stepJson["names"] = names;
+        }
+        if (isDelta && keyframe) {
+            stepJson["keyframe"] = true;
+        }
+        if (isDelta && !swaps.empty()) {
+            stepJson["swap"] = swaps;
+        }
         stepJson["pivot"] = pivotIndex;
         stepJson["left"] = leftPointer;
         stepJson["right"] = rightPointer;
@@ -34,128 +97,256 @@ struct SortStep {
         stepJson["high"] = high;
         return stepJson;
     }
+    
+    // Same content as toJSON, written straight to a stream
+    void writeJSON(JsonWriter& out) const {
+        out.beginObject();
+        out.field("step", stepNum);
+        out.field("code", sortStepCodeName(code));
+        if (!action.empty()) {
+            out.field("action", action);
+            out.field("explanation", explanation);
+        }
+        if (!isDelta || keyframe) {
+            out.field("array", array);
+            out.field("names", names);
+        }
+        if (isDelta && keyframe) {
+            out.field("keyframe", true);
+        }
+        if (isDelta && !swaps.empty()) {
+            out.field("swap", swaps);
+        }
+        out.field("pivot", pivotIndex);
+        out.field("left", leftPointer);
+        out.field("right", rightPointer);
+        out.field("low", low);
+        out.field("high", high);
+        out.endObject();
+    }
 };
 
 class QuickSortVisualizer {
 private:
-    vector<SortStep> steps;
+    Arena& arena;                         // Trace data, released after the response is sent
+    Arena::Mark streamMark;               // Streaming: arena position to rewind to after each step
+    ArenaVector<SortStep> steps;
     int stepNum;
     vector<int> distances;
-    vector<string> names;
+    vector<string_view> names;
+    TraceFormat format;
+    ArenaVector<pair<int, int>> pendingSwaps;  // Swaps since the last recorded step (delta traces)
+    JsonWriter* stream;                   // When set, steps are written here instead of kept
+    const vector<int>* networkDistances;  // Walking distances from the reference, or null for straight-line
+    bool withText;                        // Render action/explanation text into each step
+    string referenceName;
+    
+    // Swap two entries, remembering the swap for delta traces
+    void swapEntries(int i, int j) {
+        swap(distances[i], distances[j]);
+        swap(names[i], names[j]);
+        if (format == TRACE_DELTA) {
+            pendingSwaps.push_back({i, j});
+        }
+    }
+    
+    // English text for a step from the current array, only built when asked for
+    void describe(SortStep& step, int pivot, int left, int right, int low, int high) const {
+        string metricName = networkDistances ? "walking distance" : "distance";
+        switch (step.code) {
+            case SORT_INIT:
+                step.action = "Initial array";
+                step.explanation = "Sorting " + to_string(distances.size()) + " buildings by " + metricName +
+                                   " from " + referenceName;
+                break;
+            case SORT_PARTITION:
+                step.action = "Partition";
+                step.explanation = "Sorting subarray from index " + to_string(low) + " to " + to_string(high);
+                break;
+            case SORT_PIVOT:
+                step.action = "Choose pivot";
+                step.explanation = "Selected pivot (median of first, middle and last): " + to_string(distances[pivot]) +
+                                   "m (" + string(names[pivot]) + ") at index " + to_string(pivot);
+                break;
+            case SORT_COMPARE:
+                step.action = "Comparing";
+                step.explanation = "Compare " + to_string(distances[right]) + "m (" + string(names[right]) +
+                                   ") with pivot " + to_string(distances[pivot]) + "m";
+                break;
+            case SORT_SWAP:
+                step.action = "Swap";
+                step.explanation = "Swapped " + string(names[left]) + " and " + string(names[right]) +
+                                   " (both smaller than pivot)";
+                break;
+            case SORT_PLACE:
+                step.action = "Place pivot";
+                step.explanation = "Placed pivot " + string(names[pivot]) + " at its final position (index " +
+                                   to_string(pivot) + ")";
+                break;
+            case SORT_DONE:
+                step.action = "Sorted!";
+                step.explanation = "Array is now sorted by " + metricName + " from " + referenceName;
+                break;
+        }
+    }
     
     // Record each step of the quicksort process
-    void recordStep(const string& action, const string& explanation,
-                   int pivot, int left, int right, int low, int high) {
-        SortStep currentStep;
+    void recordStep(SortStepCode code, int pivot, int left, int right, int low, int high) {
+        SortStep currentStep(arena);
         currentStep.stepNum = stepNum++;
-        currentStep.action = action;
-        currentStep.explanation = explanation;
-        currentStep.array = distances;
-        currentStep.names = names;
+        currentStep.code = code;
+        if (withText) describe(currentStep, pivot, left, right, low, high);
+        if (format == TRACE_DELTA) {
+            currentStep.isDelta = true;
+            currentStep.keyframe = isKeyframe(currentStep.stepNum);
+            if (currentStep.keyframe) {
+                currentStep.array.assign(distances.begin(), distances.end());
+                currentStep.names.assign(names.begin(), names.end());
+            } else {
+                currentStep.swaps = move(pendingSwaps);
+            }
+        } else {
+            currentStep.array.assign(distances.begin(), distances.end());
+            currentStep.names.assign(names.begin(), names.end());
+        }
         currentStep.pivotIndex = pivot;
         currentStep.leftPointer = left;
         currentStep.rightPointer = right;
         currentStep.low = low;
         currentStep.high = high;
-        steps.push_back(currentStep);
+        if (stream) {
+            // Written and no longer read: the next step reuses its memory
+            currentStep.writeJSON(*stream);
+            arena.rewind(streamMark);
+        } else {
+            steps.push_back(move(currentStep));
+        }
+        pendingSwaps = ArenaVector<pair<int, int>>(&arena);
+    }
+    
+    // Move the median of array[low], array[mid] and array[high] to high, so
+    // sorted and reversed input split evenly instead of degrading to O(n²)
+    void choosePivot(int low, int high) {
+        int mid = low + (high - low) / 2;
+        int a = distances[low], b = distances[mid], c = distances[high];
+        int median;
+        if ((a <= b && b <= c) || (c <= b && b <= a)) median = mid;
+        else if ((b <= a && a <= c) || (c <= a && a <= b)) median = low;
+        else median = high;
+        if (median != high) swapEntries(median, high);     // In delta traces the swap rides on the pivot step
     }
     
     // Partition the array around a pivot element
 
     int partition(int low, int high) {                      // All elements smaller than pivot go to left, larger go to right
-        int pivot = distances[high];                    // Choose the last element as pivot
-        string pivotName = names[high];
+        choosePivot(low, high);
+        int pivot = distances[high];                    // Median of three, now the last element
         
-        recordStep("Choose pivot",
-                  "Selected pivot: " + to_string(pivot) + "m (" + pivotName + ") at index " + to_string(high),
-                  high, -1, -1, low, high);
+        recordStep(SORT_PIVOT, high, -1, -1, low, high);
         
         int i = low - 1;                   // Index of smaller element (partition point)
         
         for (int j = low; j < high; j++) {              // Compare each element with pivot
-            recordStep("Comparing",
-                      "Compare " + to_string(distances[j]) + "m (" + names[j] + ") with pivot " + 
-                      to_string(pivot) + "m",
-                      high, i, j, low, high);
+            recordStep(SORT_COMPARE, high, i, j, low, high);
             
             if (distances[j] < pivot) {                // If current element is smaller than pivot
                 i++;
                 
-                swap(distances[i], distances[j]);                 // Swap distances and names
-                swap(names[i], names[j]);
+                swapEntries(i, j);                 // Swap distances and names
                 
-                recordStep("Swap",
-                          "Swapped " + names[i] + " and " + names[j] + 
-                          " (both smaller than pivot)",
-                          high, i, j, low, high);
+                recordStep(SORT_SWAP, high, i, j, low, high);
             }
         }
         
-        swap(distances[i + 1], distances[high]);          // Place pivot in its correct sorted position
-        swap(names[i + 1], names[high]);
+        swapEntries(i + 1, high);          // Place pivot in its correct sorted position
         
-        recordStep("Place pivot",
-                  "Placed pivot " + names[i + 1] + " at its final position (index " + 
-                  to_string(i + 1) + ")",
-                  i + 1, -1, -1, low, high);
+        recordStep(SORT_PLACE, i + 1, -1, -1, low, high);
         
         return i + 1;
     }
     
-    void quicksort(int low, int high) {       // Recursive quicksort function
+    // Recurse into the smaller side and loop on the larger one, so the stack
+    // never holds more than O(log n) frames
+    void quicksort(int low, int high) {
 
-        if (low < high) {           // Base case: if low >= high, subarray has 0 or 1 element (already sorted)
-            recordStep("Partition",
-                      "Sorting subarray from index " + to_string(low) + " to " + to_string(high),
-                      -1, -1, -1, low, high);
+        while (low < high) {           // A subarray of 0 or 1 element is already sorted
+            recordStep(SORT_PARTITION, -1, -1, -1, low, high);
             
             int pivotIndex = partition(low, high);               // Partition the array and get pivot position
             
-            quicksort(low, pivotIndex - 1);               // Recursively sort elements before and after pivot
-            quicksort(pivotIndex + 1, high);
+            if (pivotIndex - low < high - pivotIndex) {
+                quicksort(low, pivotIndex - 1);
+                low = pivotIndex + 1;
+            } else {
+                quicksort(pivotIndex + 1, high);
+                high = pivotIndex - 1;
+            }
         }
     }
     
 public:
-    QuickSortVisualizer() : stepNum(0) {}
+    // networkDistances, if given, holds the walking distance from the reference
+    // node to every node (INF if unreachable) and replaces straight-line distance
+    QuickSortVisualizer(TraceFormat format = TRACE_FULL, const vector<int>* networkDistances = nullptr,
+                        bool withText = false)
+        : arena(requestArena()), streamMark(arena.mark()), steps(&arena), stepNum(0), format(format),
+          pendingSwaps(&arena), stream(nullptr), networkDistances(networkDistances), withText(withText) {}
     
     json sort(const Graph& graph, int referenceNodeId) {
-        int totalNodes = graph.size();            // Calculate distances from reference node to all other nodes
-        distances.clear();
+        json result = run(graph, referenceNodeId);
+        
+        result["steps"] = json::array();          // Add all recorded steps for visualization
+        for (const auto& step : steps) {
+            result["steps"].push_back(step.toJSON());
+        }
+        return result;
+    }
+    
+    // Same response as sort, but each step is serialized as soon as it is
+    // recorded and the summary fields follow the steps
+    void streamSort(const Graph& graph, int referenceNodeId, JsonWriter& out) {
+        stream = &out;
+        streamMark = arena.mark();
+        out.beginObject();
+        out.key("steps");
+        out.beginArray();
+        json summary = run(graph, referenceNodeId);
+        out.endArray();
+        out.fields(summary);
+        out.endObject();
+        stream = nullptr;
+    }
+    
+private:
+    // Sort, recording steps, and return every response field but "steps"
+    json run(const Graph& graph, int referenceNodeId) {
+        distances.clear();            // Calculate distances from reference node to all other nodes
         names.clear();
         
-        const Node& referenceNode = graph.getNode(referenceNodeId);
+        referenceName = string(graph.getName(referenceNodeId));
         
-        for (int i = 0; i < totalNodes; i++) {            // Loop through all nodes and calculate their distance from reference
-            if (i != referenceNodeId) {
-                const Node& currentNode = graph.getNode(i);
-                
-                double dx = currentNode.x - referenceNode.x;                   // Calculate Euclidean distance using Pythagorean theorem
-                double dy = currentNode.y - referenceNode.y;
-                int distance = static_cast<int>(sqrt(dx * dx + dy * dy));
-                
-                distances.push_back(distance);
-                names.push_back(currentNode.name);
-            }
+        int unreachable;
+        for (const auto& item : rankingCandidates(graph, referenceNodeId, networkDistances, unreachable)) {
+            distances.push_back(item.distance);
+            names.push_back(graph.getName(item.id));
         }
-        recordStep("Initial array",    
-                  "Sorting " + to_string(distances.size()) + 
-                  " buildings by distance from " + referenceNode.name,
-                  -1, -1, -1, 0, distances.size() - 1);            // Record initial unsorted state
+        recordStep(SORT_INIT, -1, -1, -1, 0, distances.size() - 1);            // Record initial unsorted state
 
         
         if (!distances.empty()) {            // Perform quicksort
             quicksort(0, distances.size() - 1);
         }
         
-        recordStep("Sorted!",            // Record final sorted state
-                  "Array is now sorted by distance from " + referenceNode.name,
-                  -1, -1, -1, 0, distances.size() - 1);
+        recordStep(SORT_DONE, -1, -1, -1, 0, distances.size() - 1);            // Record final sorted state
         
         json result;           // Build JSON response with all sorting information
         result["algorithm"] = "quicksort";
         result["referenceNode"] = referenceNodeId;
-        result["referenceName"] = referenceNode.name;
+        result["referenceName"] = referenceName;
+        if (networkDistances) {
+            result["metric"] = "network";
+            result["unreachable"] = unreachable;
+        }
         
         result["sortedLocations"] = json::array();           // Add sorted locations to result
         for (size_t i = 0; i < distances.size(); i++) {
@@ -165,23 +356,33 @@ public:
             });
         }
         
-        result["steps"] = json::array();          // Add all recorded steps for visualization
-        for (const auto& step : steps) {
-            result["steps"].push_back(step.toJSON());
+        if (format == TRACE_DELTA) {
+            result["trace"] = traceFormatName(format);
+            result["keyframeInterval"] = TRACE_KEYFRAME_INTERVAL;
         }
         
         result["complexity"] = {          // Include algorithm complexity information
             {"time_avg", "O(n log n)"},
             {"time_worst", "O(n²)"},
-            {"space", "O(log n)"},
-            {"description", "In-place sorting with random pivot"}
+            {"space", "O(log n) recursion"},
+            {"description", "In-place Lomuto partition around a median-of-three pivot, recursing into the smaller side; "
+                            "sorted or reversed input stays O(n log n), many equal distances are the O(n²) case"}
         };
         
         return result;
     }
 };
 
-json sortLocationsByDistance(const Graph& graph, int referenceNodeId) {   // Main function to sort locations by distance from a reference node
-    QuickSortVisualizer visualizer;
+json sortLocationsByDistance(const Graph& graph, int referenceNodeId, TraceFormat format = TRACE_FULL,
+                             const vector<int>* networkDistances = nullptr,
+                             bool withText = false) {   // Main function to sort locations by distance from a reference node
+    QuickSortVisualizer visualizer(format, networkDistances, withText);
     return visualizer.sort(graph, referenceNodeId);
-}
\ No newline at end of file
+}
+
+void streamLocationsByDistance(const Graph& graph, int referenceNodeId, TraceFormat format, JsonWriter& out,
+                               const vector<int>* networkDistances = nullptr,
+                               bool withText = false) {   // Streaming variant of sortLocationsByDistance
+    QuickSortVisualizer visualizer(format, networkDistances, withText);
+    visualizer.streamSort(graph, referenceNodeId, out);
+}
@@ -0,0 +1,183 @@
+#pragma once
+#include "graph.hpp"
+#include "distance_kernel.hpp"
+#include "../lib/json.hpp"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using json = nlohmann::json;
+using namespace std;
+
+// Most nodes one nearest-node query may return
+const int MAX_NEAREST_RESULTS = 1000;
+
+// Range size at or below which the tree stops splitting
+const size_t SPATIAL_LEAF_SIZE = 16;
+
+// Static 2-d tree over the node coordinates for nearest, k-nearest and
+// within-radius queries in O(log n) for small k instead of a full scan.
+// Points are stored in parallel arrays in tree order: the median of each
+// range sits in its middle, and ranges split alternately on x and y down
+// to leaves of SPATIAL_LEAF_SIZE points, which are scanned with the
+// distance kernel.
+class SpatialIndex {
+private:
+    struct Point {
+        double x, y;
+        int id;
+        int type;   // node type code
+    };
+
+    vector<double> xs, ys;
+    vector<int> ids;
+    vector<int> types;
+
+    // Current best matches of a query, kept as a max-heap on (distance², id)
+    struct Query {
+        double x, y;
+        size_t k;
+        double radiusSquared;
+        int type;   // -1 accepts every type
+        vector<pair<double, int>> best;
+
+        // Squared distance a point must not exceed to be a candidate
+        double bound() const {
+            return best.size() < k ? radiusSquared : min(radiusSquared, best.front().first);
+        }
+    };
+
+    static void build(vector<Point>& points, size_t lo, size_t hi, int axis) {
+        if (hi - lo <= SPATIAL_LEAF_SIZE) return;
+        size_t mid = lo + (hi - lo) / 2;
+        nth_element(points.begin() + lo, points.begin() + mid, points.begin() + hi,
+                    [axis](const Point& a, const Point& b) { return axis ? a.y < b.y : a.x < b.x; });
+        build(points, lo, mid, 1 - axis);
+        build(points, mid + 1, hi, 1 - axis);
+    }
+
+    void consider(size_t i, double distanceSquared, Query& q) const {
+        if (q.type != -1 && types[i] != q.type) return;
+        pair<double, int> candidate(distanceSquared, ids[i]);
+        if (candidate.first > q.radiusSquared) return;
+
+        if (q.best.size() < q.k) {
+            q.best.push_back(candidate);
+            push_heap(q.best.begin(), q.best.end());
+        } else if (candidate < q.best.front()) {
+            pop_heap(q.best.begin(), q.best.end());
+            q.best.back() = candidate;
+            push_heap(q.best.begin(), q.best.end());
+        }
+    }
+
+    void search(size_t lo, size_t hi, int axis, Query& q) const {
+        if (lo >= hi) return;
+        if (hi - lo <= SPATIAL_LEAF_SIZE) {
+            double distances[SPATIAL_LEAF_SIZE];
+            squaredDistances(&xs[lo], &ys[lo], hi - lo, q.x, q.y, distances);
+            for (size_t i = lo; i < hi; i++) consider(i, distances[i - lo], q);
+            return;
+        }
+
+        size_t mid = lo + (hi - lo) / 2;
+        double dx = xs[mid] - q.x, dy = ys[mid] - q.y;
+        consider(mid, dx * dx + dy * dy, q);
+
+        double offset = axis ? q.y - ys[mid] : q.x - xs[mid];
+        if (offset < 0) {
+            search(lo, mid, 1 - axis, q);
+            if (offset * offset <= q.bound()) search(mid + 1, hi, 1 - axis, q);
+        } else {
+            search(mid + 1, hi, 1 - axis, q);
+            if (offset * offset <= q.bound()) search(lo, mid, 1 - axis, q);
+        }
+    }
+
+public:
+    // (Re)build from the node coordinates; call again whenever nodes change
+    void build(const Graph& graph) {
+        vector<Point> points;
+        points.reserve(graph.size());
+        for (int v = 0; v < graph.size(); v++) {
+            points.push_back({graph.getXs()[v], graph.getYs()[v], v, graph.getTypeCode(v)});
+        }
+        build(points, 0, points.size(), 0);
+
+        size_t count = points.size();
+        xs.resize(count);
+        ys.resize(count);
+        ids.resize(count);
+        types.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            xs[i] = points[i].x;
+            ys[i] = points[i].y;
+            ids[i] = points[i].id;
+            types[i] = points[i].type;
+        }
+    }
+
+    // Up to k nodes closest to (x, y), at most radius away and with the given
+    // type code unless it is -1, as (distance, id) nearest first. Equal
+    // distances are ordered by id.
+    vector<pair<double, int>> nearest(double x, double y, size_t k,
+                                      double radius = INFINITY, int typeCode = -1) const {
+        Query q;
+        q.x = x;
+        q.y = y;
+        q.k = k;
+        q.radiusSquared = radius * radius;
+        q.type = typeCode;
+        if (k == 0) return {};
+
+        q.best.reserve(min(k, ids.size()));
+        search(0, ids.size(), 0, q);
+
+        sort_heap(q.best.begin(), q.best.end());
+        for (auto& match : q.best) match.first = sqrt(match.first);
+        return q.best;
+    }
+
+    // Node closest to (x, y), -1 if the graph has no nodes
+    int snap(double x, double y) const {
+        vector<pair<double, int>> found = nearest(x, y, 1);
+        return found.empty() ? -1 : found[0].second;
+    }
+};
+
+// Nearest nodes to a point for /api/nearest
+json nearestNodes(const Graph& graph, const SpatialIndex& index, double x, double y,
+                  int k, double radius, const string& type) {
+    if (k < 1 || k > MAX_NEAREST_RESULTS) {
+        throw invalid_argument("k must be between 1 and " + to_string(MAX_NEAREST_RESULTS));
+    }
+    if (radius < 0) throw invalid_argument("radius must not be negative");
+
+    int typeCode = type.empty() ? -1 : graph.findTypeCode(type);
+    vector<pair<double, int>> found;
+    if (type.empty() || typeCode != -1) found = index.nearest(x, y, k, radius, typeCode);
+
+    json nodes = json::array();
+    for (const auto& match : found) {
+        Node node = graph.getNode(match.second);
+        nodes.push_back({
+            {"id", node.id},
+            {"name", node.name},
+            {"type", node.type},
+            {"x", node.x},
+            {"y", node.y},
+            {"distance", match.first}
+        });
+    }
+
+    json result;
+    result["x"] = x;
+    result["y"] = y;
+    result["k"] = k;
+    if (isfinite(radius)) result["radius"] = radius;
+    if (!type.empty()) result["type"] = type;
+    result["nodes"] = nodes;
+    return result;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "graph.hpp"
+#include <random>
+#include <string>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+// Buildings placed on the synthetic campus, with the name prefix for each type
+const pair<const char*, const char*> SYNTHETIC_PLACES[] = {
+    {"lecture", "Lecture Hall"}, {"lab", "Laboratory"}, {"library", "Library"},
+    {"cafeteria", "Cafeteria"}, {"hostel", "Hostel"}, {"admin", "Office"},
+    {"parking", "Parking Lot"}, {"sports", "Court"}, {"leisure", "Garden"},
+    {"entrance", "Gate"}
+};
+
+// Grid spacing and jitter of synthetic node positions
+const double SYNTHETIC_SPACING = 60;
+const double SYNTHETIC_JITTER = 20;
+
+// Every this many rows and columns the paths are roads
+const int SYNTHETIC_ROAD_EVERY = 8;
+
+// A planar campus of the given size for benchmarks and load tests: nodes on
+// a jittered grid, each joined to its right neighbour, to the node below
+// with probability 3/4 and diagonally with probability 1/10, which gives an
+// average degree of about 3.7 like a real path network. The first column is
+// always joined, so the graph is connected. Weights are the straight-line
+// length plus up to 25% detour. The same seed gives the same graph.
+Graph createSyntheticCampus(int nodes, unsigned int seed = 1) {
+    if (nodes < 1) throw invalid_argument("A synthetic campus needs at least one node");
+
+    mt19937 rng(seed);
+    uniform_real_distribution<double> jitter(-SYNTHETIC_JITTER, SYNTHETIC_JITTER);
+    uniform_real_distribution<double> detour(1.0, 1.25);
+    uniform_real_distribution<double> chance(0.0, 1.0);
+    uniform_int_distribution<int> place(0, sizeof(SYNTHETIC_PLACES) / sizeof(SYNTHETIC_PLACES[0]) - 1);
+
+    int width = static_cast<int>(ceil(sqrt(static_cast<double>(nodes))));
+    Graph g(nodes);
+    for (int v = 0; v < nodes; v++) {
+        const auto& kind = SYNTHETIC_PLACES[place(rng)];
+        double x = (v % width) * SYNTHETIC_SPACING + jitter(rng);
+        double y = (v / width) * SYNTHETIC_SPACING + jitter(rng);
+        g.addNode(v, string(kind.second) + " " + to_string(v), x, y, kind.first);
+    }
+
+    const vector<double>& xs = g.getXs();
+    const vector<double>& ys = g.getYs();
+    auto connect = [&](int from, int to, bool road) {
+        double length = hypot(xs[from] - xs[to], ys[from] - ys[to]);
+        int weight = max(1, static_cast<int>(length * detour(rng)));
+        g.addEdge(from, to, weight, road ? "road" : "walkway");
+    };
+
+    for (int v = 0; v < nodes; v++) {
+        int row = v / width, column = v % width;
+        if (column + 1 < width && v + 1 < nodes) {
+            connect(v, v + 1, row % SYNTHETIC_ROAD_EVERY == 0);
+        }
+        if (v + width < nodes && (column == 0 || chance(rng) < 0.75)) {
+            connect(v, v + width, column % SYNTHETIC_ROAD_EVERY == 0);
+        }
+        if (column + 1 < width && v + width + 1 < nodes && chance(rng) < 0.1) {
+            connect(v, v + width + 1, false);
+        }
+    }
+
+    g.buildIndexes();
+    return g;
+}
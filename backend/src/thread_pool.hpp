@@ -0,0 +1,133 @@
+#pragma once
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+#include <memory>
+
+using namespace std;
+
+// Number of workers to use when none is configured
+int defaultThreadCount() {
+    unsigned int cores = thread::hardware_concurrency();
+    return cores > 0 ? static_cast<int>(cores) : 4;
+}
+
+// Fixed set of worker threads pulling tasks from a shared FIFO queue
+class ThreadPool {
+private:
+    vector<thread> workers;
+    queue<function<void()>> tasks;
+    mutex lock;
+    condition_variable available;
+    bool stopping;
+
+    void workerLoop() {
+        while (true) {
+            function<void()> task;
+            {
+                unique_lock<mutex> guard(lock);
+                available.wait(guard, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) return;
+                task = move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+public:
+    ThreadPool(int threadCount = defaultThreadCount()) : stopping(false) {
+        if (threadCount < 1) threadCount = 1;
+        workers.reserve(threadCount);
+        for (int i = 0; i < threadCount; i++) {
+            workers.emplace_back(&ThreadPool::workerLoop, this);
+        }
+    }
+
+    // Finishes the queued tasks, then joins the workers
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        available.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(function<void()> task) {
+        {
+            lock_guard<mutex> guard(lock);
+            tasks.push(move(task));
+        }
+        available.notify_one();
+    }
+
+    int size() const {
+        return static_cast<int>(workers.size());
+    }
+};
+
+// Helper threads shared by every parallelFor call, one fewer than the cores
+// since callers work too. Concurrent requests split this fixed set instead
+// of each starting threads of their own.
+ThreadPool& computePool() {
+    static ThreadPool pool(max(defaultThreadCount() - 1, 1));
+    return pool;
+}
+
+// Run task(i) for every i in [0, count) on up to maxThreads threads, the
+// calling thread included, and wait for all of them. Threads take indexes
+// from a shared counter. Helpers come from computePool(), not from the
+// connection ThreadPool: waiting on that from one of its own workers could
+// deadlock. The caller never waits for a helper to start, so a busy pool
+// only means fewer helpers. Returns the number of threads that ran tasks.
+int parallelFor(size_t count, const function<void(size_t)>& task, int maxThreads = defaultThreadCount()) {
+    int threads = static_cast<int>(min<size_t>(count, maxThreads > 0 ? maxThreads : 1));
+    if (threads <= 1) {
+        for (size_t i = 0; i < count; i++) task(i);
+        return 1;
+    }
+
+    // Outlives the call: a helper that starts late finds no indexes left
+    // and touches nothing else
+    struct Shared {
+        atomic<size_t> next{0};
+        atomic<int> used{1};
+        mutex lock;
+        condition_variable idle;
+        int active = 0;   // helpers between taking their first index and finishing
+    };
+    auto shared = make_shared<Shared>();
+    const function<void(size_t)>* body = &task;
+    for (int k = 1; k < threads; k++) {
+        computePool().submit([shared, body, count] {
+            {
+                lock_guard<mutex> guard(shared->lock);
+                shared->active++;
+            }
+            bool worked = false;
+            for (size_t i = shared->next++; i < count; i = shared->next++) {
+                (*body)(i);
+                worked = true;
+            }
+            if (worked) shared->used++;
+            lock_guard<mutex> guard(shared->lock);
+            if (--shared->active == 0) shared->idle.notify_all();
+        });
+    }
+
+    for (size_t i = shared->next++; i < count; i = shared->next++) task(i);
+    unique_lock<mutex> guard(shared->lock);
+    shared->idle.wait(guard, [&] { return shared->active == 0; });
+    return shared->used;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+
+using namespace std;
+
+// How visualization steps are encoded in a response
+enum TraceFormat {
+    TRACE_FULL,   // every step is a full snapshot of the algorithm state
+    TRACE_DELTA   // steps carry only what changed, with periodic keyframes
+};
+
+// A delta trace stores a full snapshot every this many steps so that
+// clients can seek without replaying from the start
+const int TRACE_KEYFRAME_INTERVAL = 16;
+
+bool isKeyframe(int stepNum) {
+    return stepNum % TRACE_KEYFRAME_INTERVAL == 0;
+}
+
+// Parse the "trace" query parameter, defaulting to full snapshots
+TraceFormat parseTraceFormat(const string& value) {
+    return (value == "delta") ? TRACE_DELTA : TRACE_FULL;
+}
+
+// Parse the "text" query parameter. Steps carry a code and its arguments,
+// which clients render; English action/explanation text is opt-in.
+bool parseTraceText(const string& value) {
+    return value == "1" || value == "true";
+}
+
+const char* traceFormatName(TraceFormat format) {
+    return (format == TRACE_DELTA) ? "delta" : "full";
+}
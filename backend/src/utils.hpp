@@ -1,9 +1,14 @@
 #pragma once
 #include <string>
-#include <sstream>
+#include <string_view>
 #include <vector>
 #include <algorithm>
 #include <map>
+#include <cstdlib>
+#include <cmath>
+#include <cctype>
+#include <cerrno>
+#include <climits>
 
 using namespace std;
 
@@ -15,9 +20,18 @@ string trim(const string& str) {
     return str.substr(first, (last - first + 1));
 }
 
+// Value of one hex digit, -1 if c is not a hex digit
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
 // Decode URL-encoded strings
-string urlDecode(const string& encodeUrl) {
-    string decodeUrl = "";
+string urlDecode(string_view encodeUrl) {
+    string decodeUrl;
+    decodeUrl.reserve(encodeUrl.length());
 
     for (size_t i = 0; i < encodeUrl.length(); i++){
         char currentChar = encodeUrl[i];
@@ -25,11 +39,10 @@ string urlDecode(const string& encodeUrl) {
         // Handle percent-encoded characters (e.g., %20)
         if (currentChar == '%') {
             if (i + 2 < encodeUrl.length()){
-                string hexvalue = encodeUrl.substr(i + 1, 2);
-                int asciiValue;
-                istringstream hexConverter(hexvalue);
-                if (hexConverter >> hex >> asciiValue){
-                    decodeUrl += static_cast<char>(asciiValue);
+                int high = hexValue(encodeUrl[i + 1]);
+                int low = hexValue(encodeUrl[i + 2]);
+                if (high >= 0 && low >= 0){
+                    decodeUrl += static_cast<char>(high * 16 + low);
                     i += 2;
                 }
             }
@@ -47,70 +60,62 @@ string urlDecode(const string& encodeUrl) {
 }
 
 // Parse query parameters from URL and return a map of key-value pairs
-map<string, string> parseQueryParams(const string& query){
+map<string, string> parseQueryParams(string_view query){
     map<string, string> params;
-    istringstream queryStream(query);
-    string pair;
     
     // Split by '&' to get each key-value pair
-    while (getline(queryStream, pair, '&')){
+    while (!query.empty()){
+        size_t ampersand = query.find('&');
+        string_view pair = query.substr(0, ampersand);
+        query = (ampersand == string_view::npos) ? string_view() : query.substr(ampersand + 1);
+
         size_t equalSignPosition = pair.find('=');
-        if (equalSignPosition != string::npos){
-            string encodedKey = pair.substr(0, equalSignPosition);
-            string key = urlDecode(encodedKey);
-            string encodedValue = pair.substr(equalSignPosition + 1);
-            string value = urlDecode(encodedValue);
+        if (equalSignPosition != string_view::npos){
+            string key = urlDecode(pair.substr(0, equalSignPosition));
+            string value = urlDecode(pair.substr(equalSignPosition + 1));
             params[key] = value;
         }
     }
     return params;
 }
 
-// Extract path from HTTP request
-string extractPath(const string& request){ 
-   size_t start = request.find("GET");
-    if (start == string::npos) return "/";
-    
-    start += 4; // Skip "GET "
-    size_t end = request.find(" HTTP/", start);
-    
-    if (end != string::npos){
-        string fullPath = request.substr(start, end - start);
-        fullPath = trim(fullPath); // Trim whitespace
-        
-        size_t questionPosition = fullPath.find('?');
-        
-        // Return path without query parameters
-        if (questionPosition != string::npos){
-            return fullPath.substr(0, questionPosition);
-        }
-        else {
-            return fullPath;
-        }
+// Parse a comma-separated list of node ids such as "0,3,7"
+vector<int> parseIdList(const string& list){
+    vector<int> ids;
+    size_t start = 0;
+    while (start < list.length()){
+        size_t comma = list.find(',', start);
+        if (comma == string::npos) comma = list.length();
+        string item = trim(list.substr(start, comma - start));
+        if (!item.empty()) ids.push_back(stoi(item));
+        start = comma + 1;
     }
-    return "/";
+    return ids;
 }
 
-// Extract query string from HTTP request
-string extractQueryString(const string& request){
-    size_t start = request.find("GET");
-    if (start == string::npos) return "";
-    
-    start += 4; // Skip "GET "
-    size_t end = request.find(" HTTP/", start);
-    
-    if (end != string::npos){
-        string fullPath = request.substr(start, end - start);
-        fullPath = trim(fullPath); // Trim whitespace
-        
-        size_t questionPosition = fullPath.find('?');
-        
-        // Return everything after the '?'
-        if (questionPosition != string::npos){
-            return fullPath.substr(questionPosition + 1);
-        } else {
-            return "";
-        }
-    }
-    return "";
-}
\ No newline at end of file
+// Parse a finite number such as "400", "-2.5" or "3e2"; false unless the
+// whole value is one
+bool parseNumber(const string& value, double& number){
+    if (value.empty() || isspace(static_cast<unsigned char>(value[0]))) return false;
+    char* end;
+    number = strtod(value.c_str(), &end);
+    return *end == '\0' && isfinite(number);
+}
+
+// Parse a whole decimal integer that fits in an int, such as "42" or "-7"
+bool parseInteger(const string& value, int& integer){
+    if (value.empty() || isspace(static_cast<unsigned char>(value[0]))) return false;
+    char* end;
+    errno = 0;
+    long number = strtol(value.c_str(), &end, 10);
+    if (*end != '\0' || errno == ERANGE || number < INT_MIN || number > INT_MAX) return false;
+    integer = static_cast<int>(number);
+    return true;
+}
+
+// Parse "x,y" coordinates; false unless value is two numbers separated by a comma
+bool parsePoint(const string& value, double& x, double& y){
+    size_t comma = value.find(',');
+    if (comma == string::npos) return false;
+    return parseNumber(trim(value.substr(0, comma)), x) && parseNumber(trim(value.substr(comma + 1)), y);
+}
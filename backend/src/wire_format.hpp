@@ -0,0 +1,77 @@
+#pragma once
+#include "http.hpp"
+#include "../lib/json.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdexcept>
+
+using json = nlohmann::json;
+using namespace std;
+
+// Encoding of a response body
+enum WireFormat {
+    WIRE_JSON,
+    WIRE_MSGPACK,
+    WIRE_CBOR
+};
+
+// Parse the "format" query parameter; unknown values are rejected
+WireFormat parseWireFormat(const string& value) {
+    if (value.empty() || value == "json") return WIRE_JSON;
+    if (value == "msgpack") return WIRE_MSGPACK;
+    if (value == "cbor") return WIRE_CBOR;
+    throw invalid_argument("Unknown format: " + value);
+}
+
+const char* wireFormatName(WireFormat format) {
+    switch (format) {
+        case WIRE_MSGPACK: return "msgpack";
+        case WIRE_CBOR: return "cbor";
+        default: return "json";
+    }
+}
+
+const char* wireContentType(WireFormat format) {
+    switch (format) {
+        case WIRE_MSGPACK: return "application/msgpack";
+        case WIRE_CBOR: return "application/cbor";
+        default: return "application/json";
+    }
+}
+
+// First supported media type in an Accept header, JSON if there is none.
+// Media ranges are taken in the order listed; q-values are not weighed.
+WireFormat acceptedWireFormat(string_view accept) {
+    while (!accept.empty()) {
+        size_t comma = accept.find(',');
+        string_view range = accept.substr(0, comma);
+        range = trimView(range.substr(0, range.find(';')));
+
+        if (equalsIgnoreCase(range, "application/json")) return WIRE_JSON;
+        if (equalsIgnoreCase(range, "application/msgpack") ||
+            equalsIgnoreCase(range, "application/x-msgpack")) return WIRE_MSGPACK;
+        if (equalsIgnoreCase(range, "application/cbor")) return WIRE_CBOR;
+
+        if (comma == string_view::npos) break;
+        accept.remove_prefix(comma + 1);
+    }
+    return WIRE_JSON;
+}
+
+// The format= parameter wins over the Accept header
+WireFormat negotiateWireFormat(const string& formatParam, string_view accept) {
+    if (!formatParam.empty()) return parseWireFormat(formatParam);
+    return acceptedWireFormat(accept);
+}
+
+// Serialize a response body in the requested format
+string encodeBody(const json& result, WireFormat format) {
+    vector<uint8_t> bytes;
+    switch (format) {
+        case WIRE_MSGPACK: json::to_msgpack(result, bytes); break;
+        case WIRE_CBOR: json::to_cbor(result, bytes); break;
+        default: return result.dump();
+    }
+    return string(bytes.begin(), bytes.end());
+}
@@ -0,0 +1,126 @@
+// DistanceTable::update and FacilityTable::update must leave exactly the
+// distances a fresh build gives, with paths that add up to them, and must
+// not disturb the table they were copied from. Run with `make test`.
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../src/graph.hpp"
+#include "../src/synthetic_graph.hpp"
+#include "../src/distance_table.hpp"
+#include "../src/facility.hpp"
+
+using namespace std;
+
+int failures = 0;
+
+void check(bool ok, const string& what) {
+    if (!ok && failures++ < 20) cerr << "FAIL: " << what << endl;
+}
+
+// Every distance and path of table against a fresh build for graph
+void checkDistances(const Graph& graph, const DistanceTable& table, const string& what) {
+    DistanceTable fresh;
+    fresh.build(graph);
+    int n = graph.size();
+    for (int s = 0; s < n; s++) {
+        for (int t = 0; t < n; t++) {
+            int expected = fresh.distance(s, t);
+            if (table.distance(s, t) != expected) {
+                check(false, what + ": distance " + to_string(s) + "-" + to_string(t) + " is " +
+                      to_string(table.distance(s, t)) + ", expected " + to_string(expected));
+                continue;
+            }
+            vector<int> path = table.path(s, t);
+            if (expected == INF) {
+                check(path.empty(), what + ": path between unconnected nodes");
+                continue;
+            }
+            long long length = 0;
+            for (size_t i = 1; i < path.size(); i++) length += graph.getWeight(path[i - 1], path[i]);
+            check(!path.empty() && path.front() == s && path.back() == t && length == expected,
+                  what + ": path " + to_string(s) + "-" + to_string(t) + " does not add up");
+        }
+    }
+}
+
+void checkFacilities(const Graph& graph, const FacilityTable& table, const string& what) {
+    FacilityTable fresh;
+    fresh.build(graph);
+    set<string> types;
+    for (int v = 0; v < graph.size(); v++) types.insert(string(graph.getNode(v).type));
+    for (const string& name : types) {
+        for (int v = 0; v < graph.size(); v++) {
+            RouteResult got = table.nearest(graph, v, name);
+            RouteResult expected = fresh.nearest(graph, v, name);
+            check(got.distance == expected.distance,
+                  what + ": nearest " + name + " from " + to_string(v) + " is " + to_string(got.distance) +
+                  ", expected " + to_string(expected.distance));
+        }
+    }
+}
+
+int main() {
+    Graph graph = createSyntheticCampus(300, 7);
+    DistanceTable table;
+    table.build(graph);
+    FacilityTable facilities;
+    facilities.build(graph);
+
+    mt19937 rng(11);
+    uniform_int_distribution<int> node(0, graph.size() - 1);
+    for (int step = 0; step < 120; step++) {
+        // The same edits the /api/edges endpoints make
+        Graph next = graph;
+        const auto& edges = next.getEdges();
+        const Edge& picked = edges[rng() % edges.size()];
+        int from = picked.from, to = picked.to;
+        string kind;
+        switch (step % 4) {
+            case 0:
+                kind = "raise";
+                next.setEdgeWeight(from, to, picked.weight * 3 + 1);
+                break;
+            case 1:
+                kind = "lower";
+                next.setEdgeWeight(from, to, max(1, picked.weight / 4));
+                break;
+            case 2:
+                kind = "remove";
+                next.removeEdge(from, to);
+                break;
+            default:
+                kind = "add";
+                from = node(rng);
+                to = node(rng);
+                if (from == to) to = (to + 1) % graph.size();
+                next.addEdge(from, to, 1 + rng() % 40);
+                break;
+        }
+        next.buildAdjacency();
+        EdgeChange change = {from, to, graph.getWeight(from, to), next.getWeight(from, to)};
+        string what = "step " + to_string(step) + " (" + kind + " " + to_string(from) + "-" + to_string(to) + ")";
+
+        DistanceTable updated = table;
+        check(updated.update(next, change), what + ": all-pairs table not repairable");
+        FacilityTable updatedFacilities = facilities;
+        check(updatedFacilities.update(next, change), what + ": facility table not repairable");
+
+        checkDistances(next, updated, what);
+        checkFacilities(next, updatedFacilities, what);
+        if (step % 10 == 0) {
+            // Copies share trees: the old version must still answer for the old graph
+            checkDistances(graph, table, what + ", previous version");
+            checkFacilities(graph, facilities, what + ", previous version");
+        }
+
+        graph = move(next);
+        table = move(updated);
+        facilities = move(updatedFacilities);
+    }
+
+    if (failures == 0) cout << "distance_table_test: all checks passed" << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,60 @@
+// graphBody() must produce exactly the bytes of graphJSON().dump(), since
+// the /api/graph ETag is computed from it. Run with `make test`.
+#include <iostream>
+#include <string>
+
+#include "../src/graph.hpp"
+#include "../src/graph_json.hpp"
+
+using namespace std;
+
+int failures = 0;
+
+void check(bool ok, const string& what) {
+    if (!ok) {
+        cerr << "FAIL: " << what << endl;
+        failures++;
+    }
+}
+
+// A two-node graph whose first node has this name
+Graph namedGraph(const string& name, double x = 150, double y = 150) {
+    Graph g(2);
+    g.addNode(0, name, x, y, "building");
+    g.addNode(1, "Library", 400.5, 1e-7, "lib\trary");
+    g.addEdge(0, 1, 250, "walk\"way");
+    g.buildIndexes();
+    return g;
+}
+
+void checkSame(const Graph& g, const string& what) {
+    string streamed = graphBody(g);
+    string dumped = graphJSON(g).dump();
+    check(streamed == dumped, what + "\n  streamed: " + streamed + "\n  dumped:   " + dumped);
+}
+
+int main() {
+    string controls;
+    for (int c = 1; c < 0x20; c++) controls += static_cast<char>(c);
+    checkSame(namedGraph(controls), "every control character");
+    checkSame(namedGraph("Back\bspace \fFeed"), "backspace and form feed");
+    checkSame(namedGraph("Quote \" and back\\slash / slash \x7f"), "quotes, backslashes, DEL");
+    checkSame(namedGraph("Caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x8f\xab"), "multi-byte UTF-8");
+    checkSame(namedGraph("Zero", 0, -0.0), "zero coordinates");
+    checkSame(namedGraph("Far", 1e20, 123456789.125), "large coordinates");
+    checkSame(namedGraph("Near", 0.1, 1.0 / 3), "fractional coordinates");
+    checkSame(createCampusGraph(), "built-in campus");
+
+    // Invalid UTF-8 is rejected by both, not passed through
+    const char* invalid[] = {"Bad \xff byte", "Overlong \xc0\xaf", "Surrogate \xed\xa0\x80", "Cut \xe2\x82"};
+    for (const char* name : invalid) {
+        Graph g = namedGraph(name);
+        bool streamedThrew = false, dumpedThrew = false;
+        try { graphBody(g); } catch (const exception&) { streamedThrew = true; }
+        try { graphJSON(g).dump(); } catch (const exception&) { dumpedThrew = true; }
+        check(streamedThrew && dumpedThrew, string("invalid UTF-8 rejected: ") + name);
+    }
+
+    if (failures == 0) cout << "graph_json_test: all checks passed" << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -3,12 +3,110 @@
   Handles all backend communication
 */
 
+/*
+  MessagePack decoder for binary responses (format=msgpack).
+  Covers every type the backend's encoder emits.
+*/
+class MsgPackDecoder {
+    constructor(buffer) {
+        this.view = new DataView(buffer);
+        this.bytes = new Uint8Array(buffer);
+        this.pos = 0;
+        this.text = new TextDecoder();
+    }
+
+    static decode(buffer) {
+        return new MsgPackDecoder(buffer).read();
+    }
+
+    str(length) {
+        const value = this.text.decode(this.bytes.subarray(this.pos, this.pos + length));
+        this.pos += length;
+        return value;
+    }
+
+    array(length) {
+        const value = new Array(length);
+        for (let i = 0; i < length; i++) value[i] = this.read();
+        return value;
+    }
+
+    map(length) {
+        const value = {};
+        for (let i = 0; i < length; i++) {
+            const key = this.read();
+            value[key] = this.read();
+        }
+        return value;
+    }
+
+    bin(length) {
+        const value = this.bytes.slice(this.pos, this.pos + length);
+        this.pos += length;
+        return value;
+    }
+
+    read() {
+        const v = this.view;
+        const type = v.getUint8(this.pos++);
+        let value;
+
+        if (type <= 0x7f) return type;                        // positive fixint
+        if (type >= 0xe0) return type - 0x100;                // negative fixint
+        if ((type & 0xe0) === 0xa0) return this.str(type & 0x1f);
+        if ((type & 0xf0) === 0x90) return this.array(type & 0x0f);
+        if ((type & 0xf0) === 0x80) return this.map(type & 0x0f);
+
+        switch (type) {
+            case 0xc0: return null;
+            case 0xc2: return false;
+            case 0xc3: return true;
+            case 0xc4: value = v.getUint8(this.pos); this.pos += 1; return this.bin(value);
+            case 0xc5: value = v.getUint16(this.pos); this.pos += 2; return this.bin(value);
+            case 0xc6: value = v.getUint32(this.pos); this.pos += 4; return this.bin(value);
+            case 0xca: value = v.getFloat32(this.pos); this.pos += 4; return value;
+            case 0xcb: value = v.getFloat64(this.pos); this.pos += 8; return value;
+            case 0xcc: value = v.getUint8(this.pos); this.pos += 1; return value;
+            case 0xcd: value = v.getUint16(this.pos); this.pos += 2; return value;
+            case 0xce: value = v.getUint32(this.pos); this.pos += 4; return value;
+            case 0xcf: value = Number(v.getBigUint64(this.pos)); this.pos += 8; return value;
+            case 0xd0: value = v.getInt8(this.pos); this.pos += 1; return value;
+            case 0xd1: value = v.getInt16(this.pos); this.pos += 2; return value;
+            case 0xd2: value = v.getInt32(this.pos); this.pos += 4; return value;
+            case 0xd3: value = Number(v.getBigInt64(this.pos)); this.pos += 8; return value;
+            case 0xd9: value = v.getUint8(this.pos); this.pos += 1; return this.str(value);
+            case 0xda: value = v.getUint16(this.pos); this.pos += 2; return this.str(value);
+            case 0xdb: value = v.getUint32(this.pos); this.pos += 4; return this.str(value);
+            case 0xdc: value = v.getUint16(this.pos); this.pos += 2; return this.array(value);
+            case 0xdd: value = v.getUint32(this.pos); this.pos += 4; return this.array(value);
+            case 0xde: value = v.getUint16(this.pos); this.pos += 2; return this.map(value);
+            case 0xdf: value = v.getUint32(this.pos); this.pos += 4; return this.map(value);
+        }
+        throw new Error(`Unsupported MessagePack type 0x${type.toString(16)}`);
+    }
+}
+
 class CampusAPI {
-    constructor(baseURL = 'http://localhost:8080') {
+    /**
+     * @param {string} baseURL - Backend address
+     * @param {string} wireFormat - 'json' for trace responses the server streams while it computes
+     *   them, or 'msgpack' for smaller bodies that are only sent once the whole trace is built
+     */
+    constructor(baseURL = 'http://localhost:8080', wireFormat = 'json') {
         this.baseURL = baseURL;
+        this.wireFormat = wireFormat;
         this.graphData = null;
     }
 
+    /* Decode a response body according to its Content-Type */
+    async decode(response) {
+        const contentType = response.headers.get('Content-Type') || '';
+        if (contentType.includes('application/msgpack')) {
+            return MsgPackDecoder.decode(await response.arrayBuffer());
+        }
+        return await response.json();
+    }
+
     /* Fetch campus graph data */
     async getGraph() {
         try {
@@ -28,22 +126,44 @@ class CampusAPI {
      * Get Dijkstra's shortest path
      * @param {number} start - Start node ID
      * @param {number} end - End node ID
+     * @param {string} algorithm - 'dijkstra' or 'astar'
      */
-    async getDijkstra(start, end) {
+    async getDijkstra(start, end, algorithm = 'dijkstra') {
         try {
             const response = await fetch(
-                `${this.baseURL}/api/dijkstra?start=${start}&end=${end}`
+                `${this.baseURL}/api/dijkstra?start=${start}&end=${end}&algorithm=${algorithm}&trace=delta&format=${this.wireFormat}`
             );
             if (!response.ok) {
                 throw new Error(`HTTP error! status: ${response.status}`);
             }
-            return await response.json();
+            return await this.decode(response);
         } catch (error) {
             console.error('Error fetching Dijkstra:', error);
             throw error;
         }
     }
 
+    /**
+     * Get the shortest path without a visualization trace
+     * @param {number} start - Start node ID
+     * @param {number} end - End node ID
+     * @param {string} algorithm - 'dijkstra' or 'astar'
+     */
+    async getRoute(start, end, algorithm = 'dijkstra') {
+        try {
+            const response = await fetch(
+                `${this.baseURL}/api/route?start=${start}&end=${end}&algorithm=${algorithm}`
+            );
+            if (!response.ok) {
+                throw new Error(`HTTP error! status: ${response.status}`);
+            }
+            return await response.json();
+        } catch (error) {
+            console.error('Error fetching route:', error);
+            throw error;
+        }
+    }
+
     /**
      * Search for a building
      * @param {string} query - Building name to search for
@@ -63,6 +183,26 @@ class CampusAPI {
         }
     }
 
+    /**
+     * Typeahead suggestions for a partial building name
+     * @param {string} query - Text typed so far
+     * @param {number} limit - Maximum number of suggestions
+     */
+    async suggestBuildings(query, limit = 10) {
+        try {
+            const response = await fetch(
+                `${this.baseURL}/api/search/suggest?query=${encodeURIComponent(query)}&limit=${limit}`
+            );
+            if (!response.ok) {
+                throw new Error(`HTTP error! status: ${response.status}`);
+            }
+            return await response.json();
+        } catch (error) {
+            console.error('Error fetching suggestions:', error);
+            throw error;
+        }
+    }
+
     /**
      * Sort locations by distance
      * @param {number} reference - Reference node ID
@@ -70,18 +210,62 @@ class CampusAPI {
     async sortByDistance(reference) {
         try {
             const response = await fetch(
-                `${this.baseURL}/api/sort?reference=${reference}`
+                `${this.baseURL}/api/sort?reference=${reference}&trace=delta&format=${this.wireFormat}`
             );
             if (!response.ok) {
                 throw new Error(`HTTP error! status: ${response.status}`);
             }
-            return await response.json();
+            return await this.decode(response);
         } catch (error) {
             console.error('Error sorting:', error);
             throw error;
         }
     }
 
+    /**
+     * Nodes closest to a point
+     * @param {number} x - X coordinate
+     * @param {number} y - Y coordinate
+     * @param {Object} options - k (count), radius and type ('food', 'parking', ...)
+     */
+    async getNearest(x, y, { k, radius, type } = {}) {
+        try {
+            let url = `${this.baseURL}/api/nearest?x=${x}&y=${y}`;
+            if (k !== undefined) url += `&k=${k}`;
+            if (radius !== undefined) url += `&radius=${radius}`;
+            if (type) url += `&type=${encodeURIComponent(type)}`;
+            const response = await fetch(url);
+            if (!response.ok) {
+                throw new Error(`HTTP error! status: ${response.status}`);
+            }
+            return await response.json();
+        } catch (error) {
+            console.error('Error fetching nearest nodes:', error);
+            throw error;
+        }
+    }
+
+    /**
+     * Closest places of a type by walking distance
+     * @param {number} source - Start node ID
+     * @param {string} type - Node type, e.g. 'cafeteria'
+     * @param {number} k - Number of places
+     */
+    async getNearestFacility(source, type, k = 1) {
+        try {
+            const response = await fetch(
+                `${this.baseURL}/api/nearest/facility?source=${source}&type=${encodeURIComponent(type)}&k=${k}`
+            );
+            if (!response.ok) {
+                throw new Error(`HTTP error! status: ${response.status}`);
+            }
+            return await response.json();
+        } catch (error) {
+            console.error('Error fetching nearest facility:', error);
+            throw error;
+        }
+    }
+
     /**
      * Check if server is running
      */
@@ -7,6 +7,7 @@ class CampusNavigatorApp {
     constructor() {
         this.currentAlgorithm = null;
         this.steps = [];
+        this.traceData = null;
         this.currentStep = 0;
         this.isPlaying = false;
         this.playInterval = null;
@@ -53,8 +54,9 @@ class CampusNavigatorApp {
     return -1  // not found`,
             
             sort: `function quicksort(array, low, high):
-    if low < high:
-        // Partition the array
+    while low < high:
+        // Median of first, middle, last as pivot
+        move median(array[low], array[mid], array[high]) to high
         pivot = array[high]
         i = low - 1
         
@@ -66,9 +68,13 @@ class CampusNavigatorApp {
         swap array[i + 1] with array[high]
         pivotIndex = i + 1
         
-        // Recursively sort subarrays
-        quicksort(array, low, pivotIndex - 1)
-        quicksort(array, pivotIndex + 1, high)`
+        // Recurse into the smaller side, loop on the larger
+        if pivotIndex - low < high - pivotIndex:
+            quicksort(array, low, pivotIndex - 1)
+            low = pivotIndex + 1
+        else:
+            quicksort(array, pivotIndex + 1, high)
+            high = pivotIndex - 1`
         };
     }
 
@@ -237,7 +243,8 @@ class CampusNavigatorApp {
             const data = await api.getDijkstra(start, end);
             
             this.currentAlgorithm = 'dijkstra';
-            this.steps = data.steps;
+            this.steps = new TraceReplayer(data);
+            this.traceData = data;
             this.currentStep = 0;
             
             // Update UI
@@ -270,7 +277,8 @@ class CampusNavigatorApp {
             const data = await api.searchBuilding(query);
             
             this.currentAlgorithm = 'search';
-            this.steps = data.steps;
+            this.steps = new TraceReplayer(data);
+            this.traceData = data;
             this.currentStep = 0;
             this.sortedNodes = data.sortedArray;
             
@@ -304,7 +312,8 @@ class CampusNavigatorApp {
             const data = await api.sortByDistance(reference);
             
             this.currentAlgorithm = 'sort';
-            this.steps = data.steps;
+            this.steps = new TraceReplayer(data);
+            this.traceData = data;
             this.currentStep = 0;
             
             // Update UI
@@ -327,7 +336,11 @@ class CampusNavigatorApp {
     displayCurrentStep() {
         if (this.steps.length === 0) return;
         
-        const step = this.steps[this.currentStep];
+        const step = this.steps.at(this.currentStep);
+        
+        // Steps carry codes; render their text (kept on the step for the canvas caption)
+        const nodes = this.graphData ? this.graphData.nodes : [];
+        Object.assign(step, StepText.describe(this.currentAlgorithm, step, this.traceData, nodes));
         
         // Update step counter
         this.updateStepCounter();
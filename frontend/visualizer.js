@@ -538,5 +538,257 @@ class Visualizer {
     }
 }
 
+/**
+ * Step trace with random access
+ * Full traces are returned as is. Delta traces (trace: "delta") carry only
+ * the changes per step plus periodic keyframes; at(i) replays from the
+ * nearest keyframe and returns the same snapshot the server would have sent.
+ */
+class TraceReplayer {
+    constructor(data) {
+        this.steps = data.steps || [];
+        this.isDelta = data.trace === 'delta';
+        this.cacheIndex = -1;
+        this.cacheState = null;
+    }
+
+    get length() {
+        return this.steps.length;
+    }
+
+    at(index) {
+        if (!this.isDelta) return this.steps[index];
+
+        // Continue from the cached state when stepping forward,
+        // otherwise restart from the closest keyframe
+        let state = null;
+        let from = index;
+        if (this.cacheState && this.cacheIndex <= index &&
+            index - this.cacheIndex < this.distanceToKeyframe(index)) {
+            state = this.cacheState;
+            from = this.cacheIndex + 1;
+        } else {
+            while (from > 0 && !this.steps[from].keyframe) from--;
+        }
+
+        for (let i = from; i <= index; i++) {
+            state = TraceReplayer.apply(state, this.steps[i]);
+        }
+
+        this.cacheIndex = index;
+        this.cacheState = state;
+        return TraceReplayer.snapshot(this.steps[index], state);
+    }
+
+    distanceToKeyframe(index) {
+        let from = index;
+        while (from > 0 && !this.steps[from].keyframe) from--;
+        return index - from + 1;
+    }
+
+    // Apply one step to the replay state (mutates and returns it)
+    static apply(state, step) {
+        if (step.keyframe) {
+            return {
+                visited: step.visited ? step.visited.slice() : null,
+                distances: step.distances ? step.distances.slice() : null,
+                previous: step.previous ? step.previous.slice() : null,
+                heap: step.heap ? step.heap.map(e => e.slice()) : null,
+                array: step.array ? step.array.slice() : null,
+                names: step.names ? step.names.slice() : null
+            };
+        }
+
+        // Dijkstra queue: pops come before pushes within a step. A node is
+        // queued at most once, so a push for a queued node replaces its entry.
+        if (step.pop) state.heap.splice(0, step.pop);
+        if (step.visit !== undefined) state.visited[step.visit] = true;
+        (step.dist || []).forEach(([v, d]) => { state.distances[v] = d; });
+        (step.prev || []).forEach(([v, u]) => { state.previous[v] = u; });
+        (step.push || []).forEach(([d, v]) => {
+            const queued = state.heap.findIndex(e => e[1] === v);
+            if (queued !== -1) state.heap.splice(queued, 1);
+            let pos = state.heap.findIndex(e => e[0] > d || (e[0] === d && e[1] > v));
+            if (pos === -1) pos = state.heap.length;
+            state.heap.splice(pos, 0, [d, v]);
+        });
+
+        // Quicksort array
+        (step.swap || []).forEach(([i, j]) => {
+            [state.array[i], state.array[j]] = [state.array[j], state.array[i]];
+            [state.names[i], state.names[j]] = [state.names[j], state.names[i]];
+        });
+
+        return state;
+    }
+
+    // Build a full-format step from the delta step and replay state
+    static snapshot(step, state) {
+        const full = {};
+        const deltaKeys = ['keyframe', 'visit', 'dist', 'prev', 'pop', 'push', 'heap', 'swap'];
+        Object.keys(step).forEach(key => {
+            if (!deltaKeys.includes(key)) full[key] = step[key];
+        });
+
+        if (state.heap) {
+            full.visited = state.visited.slice();
+            full.distances = state.distances.slice();
+            full.previous = state.previous.slice();
+            full.queue = state.heap.map(e => e[1]);
+        }
+        if (state.array) {
+            full.array = state.array.slice();
+            full.names = state.names.slice();
+        }
+        return full;
+    }
+}
+
+/**
+ * Step text
+ * Steps carry a code and its arguments instead of English text (the server
+ * only adds action/explanation with text=1). describe() renders the same
+ * sentences from the step, the response it came from and the node names.
+ */
+class StepText {
+    /**
+     * @param {string} algorithm - 'dijkstra', 'search' or 'sort'
+     * @param {Object} step - Full-format step, e.g. from TraceReplayer.at
+     * @param {Object} data - The response the step belongs to
+     * @param {Array} nodes - Graph nodes, for Dijkstra node names
+     * @returns {{action: string, explanation: string}}
+     */
+    static describe(algorithm, step, data, nodes = []) {
+        if (step.action !== undefined) {
+            return { action: step.action, explanation: step.explanation };
+        }
+        switch (algorithm) {
+            case 'dijkstra': return StepText.dijkstra(step, data, nodes);
+            case 'search': return StepText.search(step, data);
+            case 'sort': return StepText.sort(step, data);
+        }
+        return { action: '', explanation: '' };
+    }
+
+    static nodeName(nodes, id) {
+        const node = nodes[id] && nodes[id].id === id ? nodes[id] : nodes.find(n => n.id === id);
+        return node ? node.name : `#${id}`;
+    }
+
+    static dijkstra(step, data, nodes) {
+        const name = StepText.nodeName(nodes, step.node);
+        switch (step.code) {
+            case 'start':
+                return {
+                    action: `Starting at ${name}`,
+                    explanation: 'Initialize distance to start node as 0, all others as infinity. ' +
+                                 'Add start node to priority queue.'
+                };
+            case 'visit':
+                return {
+                    action: `Visiting ${name}`,
+                    explanation: step.h !== undefined
+                        ? `Selected ${name} as it has the minimum estimated total (${step.d}m walked + ` +
+                          `${step.h}m to go) among unvisited nodes. Mark it as visited.`
+                        : `Selected ${name} as it has the minimum distance (${step.d}m) among unvisited nodes. ` +
+                          'Mark it as visited.'
+                };
+            case 'relax': {
+                const target = StepText.nodeName(nodes, step.v);
+                return {
+                    action: `Relaxing edge to ${target}`,
+                    explanation: `Found shorter path to ${target} via ${name}. ` +
+                                 `Updated distance: ${step.d}m (previous: ${step.d}m).`
+                };
+            }
+            case 'reached':
+                return {
+                    action: `Reached destination: ${name}`,
+                    explanation: `Found shortest path! Total distance: ${step.d}m`
+                };
+        }
+        return { action: step.code, explanation: '' };
+    }
+
+    static search(step, data) {
+        const query = data.query;
+        const mid = step.mid >= 0 && data.sortedArray[step.mid] ? data.sortedArray[step.mid].name : '';
+        switch (step.code) {
+            case 'start':
+                return {
+                    action: 'Starting binary search',
+                    explanation: `Array is sorted alphabetically. Searching for: ${query}`
+                };
+            case 'check':
+                return {
+                    action: 'Checking middle element',
+                    explanation: `Range: [${step.left}, ${step.right}]. Midpoint: ${step.mid} (${mid})`
+                };
+            case 'found':
+                return { action: 'Found!', explanation: `'${query}' matches '${mid}' at index ${step.mid}` };
+            case 'left':
+                return {
+                    action: 'Search left half',
+                    explanation: `'${query}' < '${mid}'. Discard right half and search left.`
+                };
+            case 'right':
+                return {
+                    action: 'Search right half',
+                    explanation: `'${query}' > '${mid}'. Discard left half and search right.`
+                };
+            case 'notfound':
+                return {
+                    action: 'Not found',
+                    explanation: `Search completed. '${query}' not found in the campus.`
+                };
+        }
+        return { action: step.code, explanation: '' };
+    }
+
+    static sort(step, data) {
+        const metric = data.metric === 'network' ? 'walking distance' : 'distance';
+        const array = step.array || [];
+        const names = step.names || [];
+        switch (step.code) {
+            case 'init':
+                return {
+                    action: 'Initial array',
+                    explanation: `Sorting ${array.length} buildings by ${metric} from ${data.referenceName}`
+                };
+            case 'partition':
+                return {
+                    action: 'Partition',
+                    explanation: `Sorting subarray from index ${step.low} to ${step.high}`
+                };
+            case 'pivot':
+                return {
+                    action: 'Choose pivot',
+                    explanation: `Selected pivot (median of first, middle and last): ${array[step.pivot]}m (${names[step.pivot]}) at index ${step.pivot}`
+                };
+            case 'compare':
+                return {
+                    action: 'Comparing',
+                    explanation: `Compare ${array[step.right]}m (${names[step.right]}) with pivot ${array[step.pivot]}m`
+                };
+            case 'swap':
+                return {
+                    action: 'Swap',
+                    explanation: `Swapped ${names[step.left]} and ${names[step.right]} (both smaller than pivot)`
+                };
+            case 'place':
+                return {
+                    action: 'Place pivot',
+                    explanation: `Placed pivot ${names[step.pivot]} at its final position (index ${step.pivot})`
+                };
+            case 'sorted':
+                return {
+                    action: 'Sorted!',
+                    explanation: `Array is now sorted by ${metric} from ${data.referenceName}`
+                };
+        }
+        return { action: step.code, explanation: '' };
+    }
+}
+
 // Create global visualizer instance
 const visualizer = new Visualizer('main-canvas');
\ No newline at end of file